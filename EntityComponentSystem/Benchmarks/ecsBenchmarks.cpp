@@ -0,0 +1,986 @@
+#include "EntitiesManager.hpp"
+#include "PhysicsComponent.hpp"
+#include "LifetimeComponent.hpp"
+#include "MoveSystem.hpp"
+#include "DecLifetimeSystem.hpp"
+#include "LifetimeWheel.hpp"
+#include "Scheduler.hpp"
+#include "ArchetypeStorage.hpp"
+#include "PageBacked.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <future>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Usage: ecs_bench [--benchmark_filter=<substring>] [--benchmark_out=<file>]
+// Runs the reports whose name contains the filter (all of them by default) and prints their tables.
+// With --benchmark_out every figure is also written to file as JSON, in the format Google Benchmark writes,
+// so two runs can be compared with its tools, e.g. compare.py benchmarks before.json after.json
+namespace
+{
+	constexpr std::size_t poolCapacity{ 1U << 16U };
+	constexpr std::size_t batchSize{ 64U };
+	constexpr std::size_t roundsPerThread{ 20'000U };
+
+	using PhysicsPool = ecs::ComponentPool<ecs::PhysicsComponent, poolCapacity>;
+	using Manager = ecs::EntitiesManager<poolCapacity, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+
+	// iterations_ runs of a benchmark took elapsed_ wall time, each processing itemsPerIteration_ items
+	struct Timed
+	{
+		std::size_t iterations_;
+		std::size_t itemsPerIteration_;
+		std::chrono::duration<double> elapsed_;
+
+		[[nodiscard]] double nsPerIteration() const noexcept
+		{
+			return elapsed_.count() * 1e9 / static_cast<double>(iterations_);
+		}
+
+		[[nodiscard]] double usPerIteration() const noexcept
+		{
+			return nsPerIteration() / 1e3;
+		}
+
+		[[nodiscard]] double msPerIteration() const noexcept
+		{
+			return nsPerIteration() / 1e6;
+		}
+
+		// millions of items per second
+		[[nodiscard]] double mops() const noexcept
+		{
+			return static_cast<double>(iterations_ * itemsPerIteration_) / elapsed_.count() / 1e6;
+		}
+	};
+
+	template <typename Benchmark>
+	[[nodiscard]] Timed time_iterations(std::size_t iterations, std::size_t itemsPerIteration, Benchmark benchmark)
+	{
+		const auto start{ std::chrono::steady_clock::now() };
+		for (std::size_t iteration{ 0U }; iteration != iterations; ++iteration)
+		{
+			benchmark();
+		}
+		return Timed{ iterations, itemsPerIteration, std::chrono::steady_clock::now() - start };
+	}
+
+	// the figures every report prints, named after Google Benchmark's "family/argument:value" convention
+	class Results
+	{
+	public:
+		void add(std::string name, const Timed& timed)
+		{
+			entries_.push_back(Entry{ std::move(name), timed });
+		}
+
+		// false if file couldn't be written
+		[[nodiscard]] bool write(const std::string& path, std::string_view executable) const
+		{
+			std::FILE* file{ std::fopen(path.c_str(), "w") };
+			if (file == nullptr)
+			{
+				return false;
+			}
+
+			char date[32]{};
+			const std::time_t now{ std::time(nullptr) };
+			std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+
+#ifdef NDEBUG
+			constexpr const char* buildType{ "release" };
+#else
+			constexpr const char* buildType{ "debug" };
+#endif
+			std::fprintf(file, "{\n  \"context\": {\n");
+			std::fprintf(file, "    \"date\": \"%s\",\n", date);
+			std::fprintf(file, "    \"executable\": \"%s\",\n", escaped(executable).c_str());
+			std::fprintf(file, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+			std::fprintf(file, "    \"library_build_type\": \"%s\"\n  },\n  \"benchmarks\": [", buildType);
+
+			// only wall time is measured, cpu_time repeats it so the tools comparing runs find both
+			for (std::size_t i{ 0U }; i != entries_.size(); ++i)
+			{
+				const Entry& entry{ entries_[i] };
+				const std::string name{ escaped(entry.name_) };
+				std::fprintf(file, "%s\n    {\n", i == 0U ? "" : ",");
+				std::fprintf(file, "      \"name\": \"%s\",\n      \"run_name\": \"%s\",\n", name.c_str(), name.c_str());
+				std::fprintf(file, "      \"run_type\": \"iteration\",\n      \"repetitions\": 1,\n      \"repetition_index\": 0,\n      \"threads\": 1,\n");
+				std::fprintf(file, "      \"iterations\": %zu,\n", entry.timed_.iterations_);
+				std::fprintf(file, "      \"real_time\": %.6e,\n      \"cpu_time\": %.6e,\n      \"time_unit\": \"ns\",\n",
+					entry.timed_.nsPerIteration(), entry.timed_.nsPerIteration());
+				std::fprintf(file, "      \"items_per_second\": %.6e\n    }", entry.timed_.mops() * 1e6);
+			}
+			std::fprintf(file, "\n  ]\n}\n");
+
+			return std::fclose(file) == 0;
+		}
+
+	private:
+		struct Entry
+		{
+			std::string name_;
+			Timed timed_;
+		};
+
+		std::vector<Entry> entries_;
+
+		[[nodiscard]] static std::string escaped(std::string_view text)
+		{
+			std::string escapedText{};
+			for (const char c : text)
+			{
+				if (c == '"' || c == '\\')
+				{
+					escapedText.push_back('\\');
+				}
+				escapedText.push_back(c);
+			}
+			return escapedText;
+		}
+	};
+
+	// every thread repeatedly requests a batch of components and then releases it,
+	// so all threads hammer the same free-list top
+	Timed pool_contention(PhysicsPool& pool, std::size_t threadsCount)
+	{
+		std::vector<std::thread> threads{};
+		threads.reserve(threadsCount);
+
+		const auto start{ std::chrono::steady_clock::now() };
+		for (std::size_t t{ 0U }; t != threadsCount; ++t)
+		{
+			threads.emplace_back([&pool]()
+				{
+					std::vector<ecs::PooledComponent<ecs::PhysicsComponent, poolCapacity>> held{};
+					held.reserve(batchSize);
+					for (std::size_t round{ 0U }; round != roundsPerThread; ++round)
+					{
+						for (std::size_t i{ 0U }; i != batchSize; ++i)
+						{
+							held.push_back(pool.request());
+						}
+						held.clear();
+					}
+				});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		// one request plus one release per operation
+		return Timed{ threadsCount * roundsPerThread * batchSize, 1U, std::chrono::steady_clock::now() - start };
+	}
+
+	// same access pattern as above, but through EntitiesManager::requestEntity,
+	// which is served by the entities pool's per-thread magazines
+	Timed spawn_contention(Manager& entitiesManager, std::size_t threadsCount)
+	{
+		std::vector<std::thread> threads{};
+		threads.reserve(threadsCount);
+
+		const auto start{ std::chrono::steady_clock::now() };
+		for (std::size_t t{ 0U }; t != threadsCount; ++t)
+		{
+			threads.emplace_back([&entitiesManager]()
+				{
+					std::vector<Manager::Entity> held{};
+					held.reserve(batchSize);
+					for (std::size_t round{ 0U }; round != roundsPerThread; ++round)
+					{
+						for (std::size_t i{ 0U }; i != batchSize; ++i)
+						{
+							held.push_back(entitiesManager.requestEntity());
+						}
+						held.clear();
+					}
+				});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		return Timed{ threadsCount * roundsPerThread * batchSize, 1U, std::chrono::steady_clock::now() - start };
+	}
+
+	// spawns a full level of entities with both components, then releases it
+	Timed level_spawn(Manager& entitiesManager, bool batched)
+	{
+		constexpr std::size_t levels{ 20U };
+
+		return time_iterations(levels, poolCapacity, [&entitiesManager, batched]()
+			{
+				if (batched)
+				{
+					entitiesManager.releaseEntities(
+						entitiesManager.requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(poolCapacity));
+				}
+				else
+				{
+					std::vector<Manager::Entity> entities{};
+					entities.reserve(poolCapacity);
+					for (std::size_t i{ 0U }; i != poolCapacity; ++i)
+					{
+						entities.push_back(entitiesManager.requestEntity());
+						static_cast<void>(entities.back().addComponent<ecs::PhysicsComponent>());
+						static_cast<void>(entities.back().addComponent<ecs::LifetimeComponent>());
+					}
+				}
+			});
+	}
+
+	void report_level_spawn(Results& results)
+	{
+		auto entitiesManager{ std::make_unique<Manager>() };
+
+		std::printf("Level spawn with PhysicsComponent and LifetimeComponent, %zu entities\n", poolCapacity);
+		std::printf("%12s %12s\n", "mode", "Mentities/s");
+		for (const bool batched : { false, true })
+		{
+			const Timed timed{ level_spawn(*entitiesManager, batched) };
+			std::printf("%12s %12.2f\n", batched ? "batched" : "per-entity", timed.mops());
+			results.add(std::string{ "level_spawn/" } + (batched ? "batched" : "per_entity"), timed);
+		}
+		std::printf("\n");
+	}
+
+	// single threaded request and release of batchSize components or entities, one at a time and as a batch
+	void report_request_release(Results& results)
+	{
+		constexpr std::size_t rounds{ 20'000U };
+
+		auto pool{ std::make_unique<PhysicsPool>() };
+		auto entitiesManager{ std::make_unique<Manager>() };
+
+		std::vector<ecs::PooledComponent<ecs::PhysicsComponent, poolCapacity>> compos{};
+		compos.reserve(batchSize);
+		const Timed poolSingle{ time_iterations(rounds, batchSize, [&pool, &compos]()
+			{
+				for (std::size_t i{ 0U }; i != batchSize; ++i)
+				{
+					compos.push_back(pool->request());
+				}
+				compos.clear();
+			}) };
+		const Timed poolBatch{ time_iterations(rounds, batchSize, [&pool]()
+			{
+				std::vector<ecs::PooledComponent<ecs::PhysicsComponent, poolCapacity>> batch{ pool->requestBatch(batchSize) };
+				pool->releaseBatch(batch);
+			}) };
+
+		std::vector<Manager::Entity> ents{};
+		ents.reserve(batchSize);
+		const Timed managerSingle{ time_iterations(rounds, batchSize, [&entitiesManager, &ents]()
+			{
+				for (std::size_t i{ 0U }; i != batchSize; ++i)
+				{
+					ents.push_back(entitiesManager->requestEntity());
+				}
+				ents.clear();
+			}) };
+		const Timed managerBatch{ time_iterations(rounds, batchSize, [&entitiesManager]()
+			{
+				entitiesManager->releaseEntities(entitiesManager->requestEntities(batchSize));
+			}) };
+
+		std::printf("Single threaded request/release, %zu at a time\n", batchSize);
+		std::printf("%26s %12s %12s\n", "mode", "Mops/s", "ns/op");
+		const std::pair<const char*, const Timed&> rows[]{
+			{ "ComponentPool single", poolSingle }, { "ComponentPool batch", poolBatch },
+			{ "EntitiesManager single", managerSingle }, { "EntitiesManager batch", managerBatch } };
+		const char* const names[]{ "request_release/pool/single", "request_release/pool/batch",
+			"request_release/manager/single", "request_release/manager/batch" };
+		for (std::size_t i{ 0U }; i != std::size(rows); ++i)
+		{
+			std::printf("%26s %12.2f %12.2f\n", rows[i].first, rows[i].second.mops(), 1e3 / rows[i].second.mops());
+			results.add(names[i], rows[i].second);
+		}
+		std::printf("\n");
+	}
+
+	// latency of attaching, detaching and looking up a component on entities visited in random order,
+	// so every access misses the previous one's cache lines
+	void report_component_access(Results& results)
+	{
+		constexpr std::size_t passes{ 20U };
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> requested{ entitiesManager->requestEntities(poolCapacity) };
+
+		// Entity can't be swapped, hence the order is shuffled and the entities moved to it
+		std::vector<std::size_t> order(poolCapacity);
+		for (std::size_t i{ 0U }; i != poolCapacity; ++i)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937{ 3U });
+
+		std::vector<Manager::Entity> ents{};
+		std::vector<ecs::EntityHandle> handles{};
+		ents.reserve(poolCapacity);
+		handles.reserve(poolCapacity);
+		for (const std::size_t i : order)
+		{
+			ents.push_back(std::move(requested[i]));
+			handles.push_back(ents.back().getHandle());
+		}
+
+		Timed add{ 0U, 1U, {} };
+		Timed remove{ 0U, 1U, {} };
+		for (std::size_t pass{ 0U }; pass != passes; ++pass)
+		{
+			const Timed addPass{ time_iterations(1U, 1U, [&ents]()
+				{
+					for (Manager::Entity& ent : ents)
+					{
+						static_cast<void>(ent.addComponent<ecs::LifetimeComponent>());
+					}
+				}) };
+			const Timed removePass{ time_iterations(1U, 1U, [&ents]()
+				{
+					for (Manager::Entity& ent : ents)
+					{
+						static_cast<void>(ent.removeComponent<ecs::LifetimeComponent>());
+					}
+				}) };
+			add.elapsed_ += addPass.elapsed_;
+			remove.elapsed_ += removePass.elapsed_;
+		}
+		add.iterations_ = passes * poolCapacity;
+		remove.iterations_ = passes * poolCapacity;
+
+		for (Manager::Entity& ent : ents)
+		{
+			static_cast<void>(ent.addComponent<ecs::LifetimeComponent>());
+		}
+
+		std::uint64_t checksum{ 0U };
+		const Timed get{ time_iterations(passes, poolCapacity, [&ents, &checksum]()
+			{
+				for (Manager::Entity& ent : ents)
+				{
+					checksum += std::get<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime + 1U;
+				}
+			}) };
+		const Timed byHandle{ time_iterations(passes, poolCapacity, [&entitiesManager, &handles, &checksum]()
+			{
+				for (const ecs::EntityHandle handle : handles)
+				{
+					checksum -= entitiesManager->componentOf<ecs::LifetimeComponent>(handle)->lifetime + 1U;
+				}
+			}) };
+		if (checksum != 0U)
+		{
+			std::printf("getComponent and componentOf disagree\n");
+		}
+
+		std::printf("LifetimeComponent access over %zu entities in random order\n", poolCapacity);
+		std::printf("%18s %10s\n", "operation", "ns/op");
+		std::printf("%18s %10.2f\n", "addComponent", add.nsPerIteration());
+		std::printf("%18s %10.2f\n", "removeComponent", remove.nsPerIteration());
+		std::printf("%18s %10.2f\n", "getComponent", get.nsPerIteration() / static_cast<double>(poolCapacity));
+		std::printf("%18s %10.2f\n\n", "componentOf", byHandle.nsPerIteration() / static_cast<double>(poolCapacity));
+		results.add("component_access/addComponent", add);
+		results.add("component_access/removeComponent", remove);
+		results.add("component_access/getComponent", get);
+		results.add("component_access/componentOf", byHandle);
+	}
+
+	// move_system and decrease_lifetime_system over a pool whose entities are released at random
+	// until the wanted occupancy is reached
+	void report_system_iteration(Results& results)
+	{
+		constexpr std::size_t passes{ 100U };
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(poolCapacity) };
+		for (Manager::Entity& ent : ents)
+		{
+			std::get<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime = 1'000'000U;
+		}
+
+		std::printf("Systems over a pool of %zu entities\n", poolCapacity);
+		std::printf("%10s %12s %12s\n", "occupancy", "move us", "lifetime us");
+
+		std::mt19937 rng{ 13U };
+		for (const std::size_t percent : { 100U, 50U, 5U })
+		{
+			// Entity can't be swapped, hence a random subset of the rest is kept
+			const std::size_t wanted{ poolCapacity * percent / 100U };
+			std::vector<bool> keep(ents.size(), false);
+			std::fill_n(keep.begin(), wanted, true);
+			std::shuffle(keep.begin(), keep.end(), rng);
+
+			std::vector<Manager::Entity> kept{};
+			std::vector<Manager::Entity> released{};
+			for (std::size_t i{ 0U }; i != ents.size(); ++i)
+			{
+				(keep[i] ? kept : released).push_back(std::move(ents[i]));
+			}
+			ents = std::move(kept);
+			entitiesManager->releaseEntities(std::move(released));
+
+			const Timed move{ time_iterations(passes, poolCapacity, [&entitiesManager]() { ecs::move_system(*entitiesManager); }) };
+			const Timed lifetime{ time_iterations(passes, poolCapacity, [&entitiesManager]() { ecs::decrease_lifetime_system(*entitiesManager); }) };
+
+			std::printf("%9zu%% %12.2f %12.2f\n", percent, move.usPerIteration(), lifetime.usPerIteration());
+			results.add("system_iteration/move_system/occupancy:" + std::to_string(percent), move);
+			results.add("system_iteration/decrease_lifetime_system/occupancy:" + std::to_string(percent), lifetime);
+		}
+		std::printf("\n");
+	}
+
+	constexpr std::size_t movedCapacity{ 1U << 20U };
+
+	using MovedPool = ecs::ComponentPool<ecs::PhysicsComponent, movedCapacity>;
+
+	// move kernel passes over the whole pool
+	Timed move_kernel(MovedPool& pool, ecs::MoveKernel kernel)
+	{
+		constexpr std::size_t passes{ 50U };
+
+		const ecs::MoveColumns columns{
+			pool.column<&ecs::PhysicsComponent::xPos>().data(),
+			pool.column<&ecs::PhysicsComponent::yPos>().data(),
+			pool.column<&ecs::PhysicsComponent::xVelocity>().data(),
+			pool.column<&ecs::PhysicsComponent::yVelocity>().data() };
+
+		return time_iterations(passes, movedCapacity, [&pool, &columns, kernel]() { kernel(columns, pool.occupancy().words()); });
+	}
+
+	// the component and move_system loop the kernels replaced: an array of structs, 
+	// each one carrying its own valid flag, branched on per slot
+	struct ValidFlaggedPhysics
+	{
+		bool valid{ false };
+		float xPos{ 0.0f };
+		float yPos{ 0.0f };
+		float xVelocity{ 0.0f };
+		float yVelocity{ 0.0f };
+	};
+
+	Timed valid_flagged_move(std::vector<ValidFlaggedPhysics>& physComps)
+	{
+		constexpr std::size_t passes{ 50U };
+
+		return time_iterations(passes, movedCapacity, [&physComps]()
+			{
+				for (ValidFlaggedPhysics& physComp : physComps)
+				{
+					if (physComp.valid)
+					{
+						physComp.xPos += physComp.xVelocity;
+						physComp.yPos += physComp.yVelocity;
+					}
+				}
+			});
+	}
+
+	void report_move_kernels(Results& results)
+	{
+		auto pool{ std::make_unique<MovedPool>() };
+		std::vector<ecs::PooledComponent<ecs::PhysicsComponent, movedCapacity>> compos{ pool->requestBatch(movedCapacity) };
+		for (auto& compo : compos)
+		{
+			compo->xVelocity = 1.0f;
+			compo->yVelocity = 0.5f;
+		}
+
+		const ecs::SimdLevel supported{ ecs::detect_simd_level() };
+
+		std::printf("move kernels over %zu PhysicsComponent slots\n", movedCapacity);
+		std::printf("%10s %12s %10s %10s %10s %10s\n", "occupancy", "valid AoS ms", "scalar ms", "sse2 ms", "avx2 ms", "speedup");
+
+		// the same live slots as the pool, flagged as the original loop expects
+		std::vector<ValidFlaggedPhysics> validFlagged(movedCapacity);
+
+		// release components at random until the wanted occupancy is reached
+		constexpr const char* levelNames[]{ "scalar", "sse2", "avx2" };
+		std::mt19937 rng{ 7U };
+		for (const std::size_t percent : { 100U, 50U, 5U })
+		{
+			const std::size_t wanted{ movedCapacity * percent / 100U };
+			while (compos.size() > wanted)
+			{
+				std::swap(compos[std::uniform_int_distribution<std::size_t>{ 0U, compos.size() - 1U }(rng)], compos.back());
+				compos.pop_back();
+			}
+
+			for (std::size_t slot{ 0U }; slot != movedCapacity; ++slot)
+			{
+				validFlagged[slot] = ValidFlaggedPhysics{ pool->occupancy().test(slot), 0.0f, 0.0f, 1.0f, 0.5f };
+			}
+			const Timed baseline{ valid_flagged_move(validFlagged) };
+			results.add("move_kernel/valid_flagged_aos/occupancy:" + std::to_string(percent), baseline);
+
+			std::printf("%9zu%% %12.3f", percent, baseline.msPerIteration());
+			double bestMs{ baseline.msPerIteration() };
+			for (const ecs::SimdLevel level : { ecs::SimdLevel::scalar, ecs::SimdLevel::sse2, ecs::SimdLevel::avx2 })
+			{
+				if (level <= supported)
+				{
+					const Timed timed{ move_kernel(*pool, ecs::move_kernels::for_level(level)) };
+					bestMs = std::min(bestMs, timed.msPerIteration());
+					std::printf(" %10.3f", timed.msPerIteration());
+					results.add(std::string{ "move_kernel/" } + levelNames[static_cast<int>(level)] + "/occupancy:" + std::to_string(percent), timed);
+				}
+				else
+				{
+					std::printf(" %10s", "n/a");
+				}
+			}
+			// the best kernel against the original loop
+			std::printf(" %9.2fx\n", baseline.msPerIteration() / bestMs);
+		}
+		std::printf("\n");
+	}
+
+	// move_system over a full pool, split into chunks across threadsCount threads
+	Timed parallel_move(Manager& entitiesManager, std::size_t threadsCount)
+	{
+		constexpr std::size_t passes{ 200U };
+
+		// the calling thread is one of the threadsCount
+		ecs::ThreadPool threadPool{ threadsCount - 1U };
+
+		return time_iterations(passes, poolCapacity, [&entitiesManager, &threadPool]() { ecs::parallel_move_system(entitiesManager, threadPool); });
+	}
+
+	// per frame cost of launching three empty systems and waiting for them,
+	// which is pure dispatch overhead
+	void report_dispatch_overhead(Results& results)
+	{
+		constexpr std::size_t frames{ 2'000U };
+		auto emptySystem = []() {};
+
+		const Timed async{ time_iterations(frames, 3U, [&emptySystem]()
+			{
+				std::future<void> fuMove{ std::async(std::launch::async, emptySystem) };
+				std::future<void> fuDec{ std::async(std::launch::async, emptySystem) };
+				std::future<void> fuDummy{ std::async(std::launch::async, emptySystem) };
+				fuMove.get();
+				fuDec.get();
+				fuDummy.get();
+			}) };
+
+		ecs::ThreadPool threadPool{};
+		ecs::Scheduler scheduler{ threadPool };
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::PhysicsComponent>>(emptySystem);
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::LifetimeComponent>>(emptySystem);
+		scheduler.addSystem<ecs::Reads<ecs::EntityBodies>, ecs::Writes<>>(emptySystem);
+
+		const Timed scheduled{ time_iterations(frames, 3U, [&scheduler]() { scheduler.runFrame(); }) };
+
+		std::printf("Dispatch of 3 empty systems, %zu workers\n", threadPool.workersCount());
+		std::printf("%12s %12s\n", "mode", "us/frame");
+		std::printf("%12s %12.2f\n", "std::async", async.usPerIteration());
+		std::printf("%12s %12.2f\n\n", "Scheduler", scheduled.usPerIteration());
+		results.add("dispatch/std_async", async);
+		results.add("dispatch/Scheduler", scheduled);
+	}
+
+	// a Physics + Lifetime join over poolCapacity entities, half of which hold both components
+	void report_joined_iteration(Results& results)
+	{
+		constexpr std::size_t passes{ 100U };
+		using Storage = ecs::ArchetypeStorage<poolCapacity, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		auto storage{ std::make_unique<Storage>() };
+
+		// components are attached in a random order, as they would be over a level's lifetime
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(poolCapacity) };
+		std::vector<std::size_t> order(poolCapacity);
+		for (std::size_t i{ 0U }; i != poolCapacity; ++i)
+		{
+			order[i] = i;
+		}
+		std::shuffle(order.begin(), order.end(), std::mt19937{ 11U });
+		for (std::size_t i{ 0U }; i != poolCapacity / 2U; ++i)
+		{
+			static_cast<void>(ents[order[i]].addComponent<ecs::PhysicsComponent>());
+		}
+		for (std::size_t i{ 0U }; i != poolCapacity; ++i)
+		{
+			const ecs::EntityId id{ storage->create<ecs::LifetimeComponent>() };
+			if (ents[i].hasComponent<ecs::PhysicsComponent>())
+			{
+				storage->add<ecs::PhysicsComponent>(id);
+			}
+		}
+
+		auto update = [](ecs::PhysicsComponent& physComp, const ecs::LifetimeComponent& lifetimeComp)
+		{
+			physComp.xPos += static_cast<float>(lifetimeComp.lifetime) * 0.001f;
+		};
+
+		const Timed manager{ time_iterations(passes, poolCapacity, [&entitiesManager]()
+			{
+				for (auto& entBody : entitiesManager->entitiesPool().live())
+				{
+					auto* physComp{ std::get_if<ecs::PooledComponent<ecs::PhysicsComponent, poolCapacity>>(
+						&entBody.components_[ecs::componentSlot<ecs::PhysicsComponent, ecs::PhysicsComponent, ecs::LifetimeComponent>]) };
+					auto* lifetimeComp{ std::get_if<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(
+						&entBody.components_[ecs::componentSlot<ecs::LifetimeComponent, ecs::PhysicsComponent, ecs::LifetimeComponent>]) };
+					if (physComp != nullptr && lifetimeComp != nullptr)
+					{
+						(*physComp)->xPos += static_cast<float>((*lifetimeComp)->lifetime) * 0.001f;
+					}
+				}
+			}) };
+
+		const Timed archetypes{ time_iterations(passes, poolCapacity, [&storage, &update]()
+			{
+				storage->forEach<ecs::PhysicsComponent, ecs::LifetimeComponent>(update);
+			}) };
+
+		std::printf("Physics + Lifetime join over %zu entities, %zu of them matching\n", poolCapacity, poolCapacity / 2U);
+		std::printf("%18s %10s\n", "storage", "ms/pass");
+		std::printf("%18s %10.3f\n", "EntitiesManager", manager.msPerIteration());
+		std::printf("%18s %10.3f\n\n", "ArchetypeStorage", archetypes.msPerIteration());
+		results.add("joined_iteration/EntitiesManager", manager);
+		results.add("joined_iteration/ArchetypeStorage", archetypes);
+	}
+
+	// view<Physics, Lifetime> against scanning every entity, over poolCapacity entities
+	// which all hold a LifetimeComponent while only some hold a PhysicsComponent
+	void report_view_selectivity(Results& results)
+	{
+		constexpr std::size_t passes{ 50U };
+		constexpr std::size_t lifetimeSlot{ ecs::componentSlot<ecs::LifetimeComponent, ecs::PhysicsComponent, ecs::LifetimeComponent> };
+		constexpr std::size_t physicsSlot{ ecs::componentSlot<ecs::PhysicsComponent, ecs::PhysicsComponent, ecs::LifetimeComponent> };
+
+		std::printf("view<PhysicsComponent, LifetimeComponent> over %zu entities\n", poolCapacity);
+		std::printf("%12s %10s %10s\n", "selectivity", "scan ms", "view ms");
+
+		for (const double selectivity : { 0.001, 0.01, 0.1, 0.5, 1.0 })
+		{
+			auto entitiesManager{ std::make_unique<Manager>() };
+			std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(poolCapacity) };
+			std::vector<std::size_t> order(poolCapacity);
+			for (std::size_t i{ 0U }; i != poolCapacity; ++i)
+			{
+				order[i] = i;
+			}
+			std::shuffle(order.begin(), order.end(), std::mt19937{ 5U });
+
+			const std::size_t matching{ std::max<std::size_t>(static_cast<std::size_t>(selectivity * static_cast<double>(poolCapacity)), 1U) };
+			for (std::size_t i{ 0U }; i != matching; ++i)
+			{
+				static_cast<void>(ents[order[i]].addComponent<ecs::PhysicsComponent>());
+			}
+
+			std::uint64_t checksum{ 0U };
+			const Timed scan{ time_iterations(passes, poolCapacity, [&entitiesManager, &checksum]()
+				{
+					for (auto& entBody : entitiesManager->entitiesPool().live())
+					{
+						if (std::holds_alternative<ecs::PooledComponent<ecs::PhysicsComponent, poolCapacity>>(entBody.components_[physicsSlot]) &&
+							std::holds_alternative<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(entBody.components_[lifetimeSlot]))
+						{
+							checksum += std::get<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(entBody.components_[lifetimeSlot])->lifetime + 1U;
+						}
+					}
+				}) };
+
+			const Timed view{ time_iterations(passes, poolCapacity, [&entitiesManager, &checksum]()
+				{
+					for (auto [physComp, lifetimeComp] : entitiesManager->view<ecs::PhysicsComponent, ecs::LifetimeComponent>())
+					{
+						checksum -= lifetimeComp.lifetime + 1U;
+					}
+				}) };
+
+			if (checksum != 0U)
+			{
+				std::printf("view and scan disagree\n");
+			}
+			std::printf("%11.1f%% %10.3f %10.3f\n", selectivity * 100.0, scan.msPerIteration(), view.msPerIteration());
+
+			const std::string selectivityArg{ "/selectivity_permille:" + std::to_string(static_cast<int>(selectivity * 1000.0)) };
+			results.add("view_selectivity/scan" + selectivityArg, scan);
+			results.add("view_selectivity/view" + selectivityArg, view);
+		}
+		std::printf("\n");
+	}
+
+	// a million entities, where the TLB rather than the caches limits a scan of the whole manager
+	void report_page_policies(Results& results)
+	{
+		constexpr std::size_t largeCapacity{ 1U << 20U };
+		constexpr std::size_t passes{ 10U };
+		using LargeManager = ecs::EntitiesManager<largeCapacity, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+
+		std::printf("move_system and a scan of every entity body, %zu entities (%zu MiB manager)\n", largeCapacity, sizeof(LargeManager) >> 20U);
+		std::printf("%10s %10s %10s %10s\n", "requested", "got", "move ms", "scan ms");
+
+		constexpr const char* names[]{ "heap", "mmap", "hugePages" };
+		for (const ecs::PagePolicy policy : { ecs::PagePolicy::heap, ecs::PagePolicy::mmap, ecs::PagePolicy::hugePages })
+		{
+			ecs::PageBacked<LargeManager> entitiesManager{ ecs::make_page_backed<LargeManager>(policy) };
+			std::vector<LargeManager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent>(largeCapacity) };
+
+			const Timed move{ time_iterations(passes, largeCapacity, [&entitiesManager]() { ecs::move_system(*entitiesManager); }) };
+
+			std::uint64_t checksum{ 0U };
+			const Timed scan{ time_iterations(passes, largeCapacity, [&entitiesManager, &checksum]()
+				{
+					for (const auto& entBody : entitiesManager->entitiesPool().live())
+					{
+						checksum += entBody.id_;
+					}
+				}) };
+
+			if (checksum == 0U)
+			{
+				std::printf("the scan saw no ids\n");
+			}
+			std::printf("%10s %10s %10.3f %10.3f\n", names[static_cast<int>(policy)], names[static_cast<int>(entitiesManager.get_deleter().policy())],
+				move.msPerIteration(), scan.msPerIteration());
+			results.add(std::string{ "page_policy/move_system/" } + names[static_cast<int>(policy)], move);
+			results.add(std::string{ "page_policy/scan/" } + names[static_cast<int>(policy)], scan);
+		}
+		std::printf("\n");
+	}
+
+	// constructing a million entities manager and using a few of its slots,
+	// only the pages of the slots handed out are ever written, so only they become resident
+	void report_lazy_construction(Results& results)
+	{
+		constexpr std::size_t largeCapacity{ 1U << 20U };
+		using LargeManager = ecs::EntitiesManager<largeCapacity, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+
+		std::printf("constructing a %zu entities manager (%zu MiB) and requesting some of them\n", largeCapacity, sizeof(LargeManager) >> 20U);
+		std::printf("%10s %15s %15s\n", "requested", "construct ms", "resident MiB");
+
+		for (const std::size_t requested : { std::size_t{ 0U }, std::size_t{ 1U } << 10U, std::size_t{ 1U } << 16U, largeCapacity })
+		{
+			ecs::PageBacked<LargeManager> entitiesManager{};
+			const Timed construct{ time_iterations(1U, 1U, [&entitiesManager]()
+				{
+					entitiesManager = ecs::make_page_backed<LargeManager>(ecs::PagePolicy::mmap);
+				}) };
+
+			std::vector<LargeManager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(requested) };
+
+			double residentMiB{ -1.0 };
+#if defined(ECS_MMAP)
+			if (entitiesManager.get_deleter().policy() == ecs::PagePolicy::mmap)
+			{
+				const std::size_t pageBytes{ static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)) };
+				const std::size_t pagesCount{ (sizeof(LargeManager) + pageBytes - 1U) / pageBytes };
+				std::vector<unsigned char> residency(pagesCount);
+				if (::mincore(entitiesManager.get(), pagesCount * pageBytes, residency.data()) == 0)
+				{
+					const auto residentCount{ std::ranges::count_if(residency, [](unsigned char page) { return (page & 1U) != 0U; }) };
+					residentMiB = static_cast<double>(static_cast<std::size_t>(residentCount) * pageBytes) / static_cast<double>(1U << 20U);
+				}
+			}
+#endif
+			std::printf("%10zu %15.3f %15.1f\n", requested, construct.msPerIteration(), residentMiB);
+			if (requested == 0U)
+			{
+				results.add("lazy_construction/construct", construct);
+			}
+		}
+		std::printf("\n");
+	}
+
+	// a full pool of lifetimes spread over lifetimeSpan ticks, so ~1/lifetimeSpan of them expire each tick
+	void report_lifetime_expiry(Results& results)
+	{
+		constexpr std::uint32_t lifetimeSpan{ 600U };
+		constexpr std::size_t ticks{ 300U };
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(poolCapacity) };
+		auto wheel{ std::make_unique<ecs::LifetimeWheel<poolCapacity>>() };
+
+		std::mt19937 rng{ 11U };
+		for (Manager::Entity& ent : ents)
+		{
+			const std::uint32_t lifetime{ static_cast<std::uint32_t>(rng() % lifetimeSpan) + 1U };
+			std::get<ecs::PooledComponent<ecs::LifetimeComponent, poolCapacity>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime = lifetime;
+			static_cast<void>(wheel->schedule(ent.getHandle(), lifetime));
+		}
+
+		const Timed decrease{ time_iterations(ticks, poolCapacity, [&entitiesManager]() { ecs::decrease_lifetime_system(*entitiesManager); }) };
+
+		std::size_t expired{ 0U };
+		const Timed advance{ time_iterations(ticks, poolCapacity, [&wheel, &expired]() { expired += wheel->advance().size(); }) };
+
+		std::printf("Lifetime expiry, %zu entities with lifetimes in [1, %u], %zu expired in %zu ticks\n", poolCapacity, lifetimeSpan, expired, ticks);
+		std::printf("%24s %10s\n", "mode", "us/tick");
+		std::printf("%24s %10.2f\n", "decrease_lifetime_system", decrease.usPerIteration());
+		std::printf("%24s %10.2f\n\n", "LifetimeWheel::advance", advance.usPerIteration());
+		results.add("lifetime_expiry/decrease_lifetime_system", decrease);
+		results.add("lifetime_expiry/LifetimeWheel_advance", advance);
+	}
+
+	// a full manager saved to and loaded from memory, next to a plain copy of the same bytes,
+	// which is about as fast as a snapshot could be written to or read from a file in the page cache.
+	// Each load goes into a freshly constructed manager, so it pays for faulting in its pages as a restarted process would
+	void report_snapshot(Results& results)
+	{
+		constexpr std::size_t rounds{ 10U };
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(poolCapacity) };
+
+		std::ostringstream firstOut{};
+		entitiesManager->save(firstOut);
+		const std::string bytes{ std::move(firstOut).str() };
+
+		const Timed save{ time_iterations(rounds, bytes.size(), [&entitiesManager]()
+			{
+				std::ostringstream out{};
+				entitiesManager->save(out);
+			}) };
+
+		std::chrono::duration<double> loadElapsed{ 0.0 };
+		for (std::size_t round{ 0U }; round != rounds; ++round)
+		{
+			auto loadedManager{ std::make_unique<Manager>() };
+			std::istringstream in{ bytes };
+			std::vector<Manager::Entity> loaded{};
+			loadElapsed += time_iterations(1U, 0U, [&loadedManager, &in, &loaded]() { loaded = loadedManager->load(in); }).elapsed_;
+		}
+		const Timed load{ rounds, bytes.size(), loadElapsed };
+
+		std::string copied(bytes.size(), '\0');
+		const Timed copy{ time_iterations(rounds, bytes.size(), [&bytes, &copied]()
+			{
+				std::copy(bytes.begin(), bytes.end(), copied.begin());
+			}) };
+
+		std::printf("Snapshot of %zu entities with both components, %.1f MiB\n", poolCapacity, static_cast<double>(bytes.size()) / static_cast<double>(1U << 20U));
+		std::printf("%12s %10s %10s\n", "mode", "ms", "MB/s");
+		std::printf("%12s %10.3f %10.1f\n", "save", save.msPerIteration(), save.mops());
+		std::printf("%12s %10.3f %10.1f\n", "load", load.msPerIteration(), load.mops());
+		std::printf("%12s %10.3f %10.1f\n\n", "memcpy", copy.msPerIteration(), copy.mops());
+		results.add("snapshot/save", save);
+		results.add("snapshot/load", load);
+		results.add("snapshot/memcpy", copy);
+	}
+
+	// doubles the threads up to the hardware's, and at least up to minMaxThreads
+	template <typename Benchmark>
+	void report_scaling(Results& results, const char* title, const char* name, Benchmark benchmark, std::size_t minMaxThreads = 4U)
+	{
+		const std::size_t maxThreads{ std::max<std::size_t>(std::thread::hardware_concurrency(), minMaxThreads) };
+
+		std::printf("%s\n", title);
+		std::printf("%8s %12s %10s\n", "threads", "Mops/s", "scaling");
+
+		double singleThreadMops{ 0.0 };
+		for (std::size_t threadsCount{ 1U }; threadsCount <= maxThreads; threadsCount *= 2U)
+		{
+			const Timed timed{ benchmark(threadsCount) };
+			const double mops{ timed.mops() };
+			if (threadsCount == 1U)
+			{
+				singleThreadMops = mops;
+			}
+			std::printf("%8zu %12.2f %9.2fx\n", threadsCount, mops, mops / singleThreadMops);
+			results.add(std::string{ name } + "/threads:" + std::to_string(threadsCount), timed);
+		}
+		std::printf("\n");
+	}
+
+	struct Report
+	{
+		const char* name_;
+		std::function<void(Results&)> run_;
+	};
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string_view filter{};
+	std::string outPath{};
+	for (int i{ 1 }; i != argc; ++i)
+	{
+		const std::string_view arg{ argv[i] };
+		if (arg.starts_with("--benchmark_filter="))
+		{
+			filter = arg.substr(std::string_view{ "--benchmark_filter=" }.size());
+		}
+		else if (arg.starts_with("--benchmark_out="))
+		{
+			outPath = arg.substr(std::string_view{ "--benchmark_out=" }.size());
+		}
+		else
+		{
+			std::printf("usage: %s [--benchmark_filter=<substring>] [--benchmark_out=<file>]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	const Report reports[]{
+		{ "pool_contention", [](Results& results)
+			{
+				// the pools hold their slots inline, keep them off the stack
+				auto pool{ std::make_unique<PhysicsPool>() };
+				report_scaling(results, "ComponentPool<PhysicsComponent> request/release contention", "pool_contention",
+					[&pool](std::size_t threadsCount) { return pool_contention(*pool, threadsCount); });
+			} },
+		{ "spawn_contention", [](Results& results)
+			{
+				auto entitiesManager{ std::make_unique<Manager>() };
+				report_scaling(results, "EntitiesManager::requestEntity/release contention", "spawn_contention",
+					[&entitiesManager](std::size_t threadsCount) { return spawn_contention(*entitiesManager, threadsCount); },
+					// past the entities pool's 16 magazines, where further threads go to the shared stack
+					32U);
+			} },
+		{ "request_release", report_request_release },
+		{ "component_access", report_component_access },
+		{ "system_iteration", report_system_iteration },
+		{ "move_kernel", report_move_kernels },
+		{ "dispatch", report_dispatch_overhead },
+		{ "joined_iteration", report_joined_iteration },
+		{ "view_selectivity", report_view_selectivity },
+		{ "lifetime_expiry", report_lifetime_expiry },
+		{ "page_policy", report_page_policies },
+		{ "lazy_construction", report_lazy_construction },
+		{ "snapshot", report_snapshot },
+		{ "parallel_move", [](Results& results)
+			{
+				auto movers{ std::make_unique<Manager>() };
+				std::vector<Manager::Entity> ents{ movers->requestEntities<ecs::PhysicsComponent>(poolCapacity) };
+				report_scaling(results, "parallel_move_system over a full pool", "parallel_move",
+					[&movers](std::size_t threadsCount) { return parallel_move(*movers, threadsCount); });
+			} },
+		{ "level_spawn", report_level_spawn } };
+
+	Results results{};
+	for (const Report& report : reports)
+	{
+		if (std::string_view{ report.name_ }.find(filter) != std::string_view::npos)
+		{
+			report.run_(results);
+		}
+	}
+
+	if (!outPath.empty() && !results.write(outPath, argv[0]))
+	{
+		std::printf("couldn't write %s\n", outPath.c_str());
+		return 1;
+	}
+
+	return 0;
+}
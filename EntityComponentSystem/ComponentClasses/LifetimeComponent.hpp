@@ -7,7 +7,6 @@ namespace ecs
 {
 	struct LifetimeComponent
 	{
-		bool valid{ false };
 		uint32_t lifetime{ 0 };
 	};
 }
@@ -1,16 +1,38 @@
 #ifndef PHYSICS_COMPONENT
 #define PHYSICS_COMPONENT
 
+#include "SoaLayout.hpp"
+
+#include <tuple>
+
 namespace ecs
 {
 	struct PhysicsComponent
 	{
-		bool valid{ false };
 		float xPos{ 0.0f };
 		float yPos{ 0.0f };
 		float xVelocity{ 0.0f };
 		float yVelocity{ 0.0f };
 	};
+
+	// move_system only streams through the position and velocity columns
+	template <>
+	struct soa_layout<PhysicsComponent>
+	{
+		static constexpr std::tuple fields{
+			&PhysicsComponent::xPos,
+			&PhysicsComponent::yPos,
+			&PhysicsComponent::xVelocity,
+			&PhysicsComponent::yVelocity };
+
+		struct reference
+		{
+			float& xPos;
+			float& yPos;
+			float& xVelocity;
+			float& yVelocity;
+		};
+	};
 }
 
-#endif // !PHYSICS_COMPONENT
\ No newline at end of file
+#endif // !PHYSICS_COMPONENT
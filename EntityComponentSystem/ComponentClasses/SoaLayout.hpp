@@ -0,0 +1,35 @@
+#ifndef SOA_LAYOUT
+#define SOA_LAYOUT
+
+namespace ecs
+{
+	// A component opts in to structure-of-arrays storage by specializing soa_layout
+	// with a tuple of pointers to all of its data members, 
+	// and a struct of references to them, named as the members and in the same order, e.g. -
+	// 
+	// template <>
+	// struct soa_layout<MyComponent>
+	// {
+	//     static constexpr std::tuple fields{ &MyComponent::a, &MyComponent::b };
+	// 
+	//     struct reference
+	//     {
+	//         int& a;
+	//         float& b;
+	//     };
+	// };
+	// 
+	// Its pool then keeps one contiguous array per field instead of an array of components,
+	// and pooledCompo->a is a reference straight into a's array, so reading or writing a field touches that field only.
+	template <typename Component>
+	struct soa_layout;
+
+	template <typename Component>
+	concept SoaComponent = requires
+	{
+		soa_layout<Component>::fields;
+		typename soa_layout<Component>::reference;
+	};
+}
+
+#endif // !SOA_LAYOUT
@@ -0,0 +1,91 @@
+#ifndef CHROME_TRACE
+#define CHROME_TRACE
+
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <span>
+#include <string_view>
+
+namespace ecs::instrumentation
+{
+	// Writes events (see drain_events) as a Chrome trace-event JSON file, which opens offline in ui.perfetto.dev
+	// or chrome://tracing: one track per recording thread, with every system, chunk, playback and lock wait as a span on it.
+	// A chunk run by the thread running its system nests under the system's span.
+	// Times are relative to the earliest event, e.g.
+	// std::ofstream trace{ "frame.json" };
+	// instrumentation::write_chrome_trace(trace, instrumentation::drain_events());
+	void write_chrome_trace(std::ostream& out, std::span<const Event> events) noexcept(false);
+
+
+	namespace chrome_trace_detail
+	{
+		[[nodiscard]] inline const char* category(EventKind kind) noexcept
+		{
+			switch (kind)
+			{
+			case EventKind::system:
+				return "system";
+			case EventKind::lockWait:
+				return "lockWait";
+			case EventKind::chunk:
+				return "chunk";
+			case EventKind::commandFlush:
+				return "commandFlush";
+			}
+			return "unknown";
+		}
+
+		inline void write_escaped(std::ostream& out, std::string_view text)
+		{
+			for (const char c : text)
+			{
+				if (c == '"' || c == '\\')
+				{
+					out << '\\';
+				}
+				out << c;
+			}
+		}
+
+		// nanoseconds as microseconds, the unit trace events are timed in
+		inline void write_us(std::ostream& out, std::int64_t ns)
+		{
+			char buffer[32]{};
+			std::snprintf(buffer, sizeof(buffer), "%.3f", static_cast<double>(ns) / 1e3);
+			out << buffer;
+		}
+	}
+
+	inline void write_chrome_trace(std::ostream& out, std::span<const Event> events) noexcept(false)
+	{
+		const std::int64_t originNs{ events.empty() ? 0 : std::ranges::min(events, {}, &Event::beginNs_).beginNs_ };
+		const std::uint32_t threadsCount{ events.empty() ? 0U : std::ranges::max(events, {}, &Event::thread_).thread_ + 1U };
+
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+		out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"ecs\"}}";
+		for (std::uint32_t thread{ 0U }; thread != threadsCount; ++thread)
+		{
+			out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+				<< ",\"args\":{\"name\":\"thread " << thread << "\"}}";
+		}
+
+		for (const Event& event : events)
+		{
+			out << ",\n{\"name\":\"";
+			chrome_trace_detail::write_escaped(out, event.name_);
+			out << "\",\"cat\":\"" << chrome_trace_detail::category(event.kind_) << "\",\"ph\":\"X\",\"ts\":";
+			chrome_trace_detail::write_us(out, event.beginNs_ - originNs);
+			out << ",\"dur\":";
+			chrome_trace_detail::write_us(out, event.endNs_ - event.beginNs_);
+			out << ",\"pid\":1,\"tid\":" << event.thread_
+				<< ",\"args\":{\"frame\":" << event.frame_ << ",\"entities\":" << event.entities_ << "}}";
+		}
+		out << "\n]}\n";
+	}
+}
+
+#endif // !CHROME_TRACE
@@ -0,0 +1,287 @@
+#ifndef COMMAND_BUFFER
+#define COMMAND_BUFFER
+
+#include "ThreadPool.hpp"
+#include "EntitiesManager.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <vector>
+
+namespace ecs
+{
+	// Records structural changes (spawning and destroying entities, adding and removing components)
+	// requested while systems iterate the pools, and applies them later at a sync point, e.g. after Scheduler::runFrame.
+	// Every thread of threadPool records into its own buffer, so recording takes no lock.
+	// NOTE: threads outside threadPool share a single buffer, so only one of them may record at a time
+	// (e.g. the thread running the frame), and nothing may be recorded during playback
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	class CommandBuffer
+	{
+		static_assert(sizeof...(Components) <= 64U, "a spawn command keeps its components in a 64 bit mask");
+
+	public:
+		using Manager = EntitiesManager<CAPACITY, Components...>;
+		using Entity = typename Manager::Entity;
+
+		CommandBuffer(Manager& entitiesManager, ThreadPool& threadPool);
+
+		CommandBuffer(const CommandBuffer&) = delete;
+		CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+		// a new entity holding Attached
+		template <ComponentConcept... Attached>
+		void spawn();
+
+		void destroy(EntityHandle handle);
+
+		template <ComponentConcept Component>
+		void addComponent(EntityHandle handle);
+
+		template <ComponentConcept Component>
+		void removeComponent(EntityHandle handle);
+
+		// Applies and clears every recorded command in one pass, sorted by kind and then by entity slot:
+		// removals first, then additions, then destructions, and spawns last, each kind batched.
+		// Commands on entities released in the meantime are skipped, and so are additions finding their component pool full
+		// and runs of identical spawns which don't all fit in the entities pool or one of their component pools.
+		// Destroyed entities are taken out of entities, which must own them (entities owned elsewhere are left alone),
+		// and spawned entities are appended to it.
+		// returns the number of commands which took effect, less than size() was before if any were skipped.
+		// Recorded as a commandFlush event, see Instrumentation.hpp
+		std::size_t playback(std::vector<Entity>& entities) noexcept(false);
+
+		// the number of recorded commands.
+		// NOTE: mustn't be called while commands are recorded
+		[[nodiscard]] std::size_t size() const noexcept;
+
+	private:
+		enum class Op : std::uint8_t
+		{
+			remove,
+			add,
+			destroy,
+			spawn
+		};
+
+		struct Command
+		{
+			Op op_;
+			// the componentSlot for add and remove, a mask of bit (1 << componentSlot) for spawn
+			std::uint64_t components_;
+			EntityHandle handle_;
+		};
+
+		// aligned to a cache line so threads don't false share their buffers
+		struct alignas(64) Queue
+		{
+			std::vector<Command> commands_{};
+		};
+
+		Manager& entitiesManager_;
+		ThreadPool& threadPool_;
+
+		// workersCount + 1 buffers, the last one is used by threads outside the pool
+		std::vector<Queue> queues_;
+
+		// every buffer's commands merged, kept to reuse its capacity
+		std::vector<Command> sorted_;
+
+		void record(const Command& command);
+
+		[[nodiscard]] std::size_t applyDestroys(std::span<const Command> destroys, std::vector<Entity>& entities) noexcept(false);
+
+		[[nodiscard]] std::size_t applySpawns(std::span<const Command> spawns, std::vector<Entity>& entities) noexcept(false);
+	};
+
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	CommandBuffer<CAPACITY, Components...>::CommandBuffer(Manager& entitiesManager, ThreadPool& threadPool)
+		: entitiesManager_{ entitiesManager }
+		, threadPool_{ threadPool }
+		, queues_(threadPool.workersCount() + 1U)
+		, sorted_{}
+	{ }
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Attached>
+	void CommandBuffer<CAPACITY, Components...>::spawn()
+	{
+		record(Command{ Op::spawn, (std::uint64_t{ 0U } | ... | (std::uint64_t{ 1U } << componentSlot<Attached, Components...>)), EntityHandle{} });
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void CommandBuffer<CAPACITY, Components...>::destroy(EntityHandle handle)
+	{
+		record(Command{ Op::destroy, 0U, handle });
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void CommandBuffer<CAPACITY, Components...>::addComponent(EntityHandle handle)
+	{
+		record(Command{ Op::add, componentSlot<Component, Components...>, handle });
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void CommandBuffer<CAPACITY, Components...>::removeComponent(EntityHandle handle)
+	{
+		record(Command{ Op::remove, componentSlot<Component, Components...>, handle });
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::size_t CommandBuffer<CAPACITY, Components...>::playback(std::vector<Entity>& entities) noexcept(false)
+	{
+		instrumentation::SpanScope span{ instrumentation::EventKind::commandFlush, "CommandBuffer::playback" };
+
+		sorted_.clear();
+		for (Queue& queue : queues_)
+		{
+			sorted_.insert(sorted_.end(), queue.commands_.cbegin(), queue.commands_.cend());
+			queue.commands_.clear();
+		}
+
+		// entity slot order, so each pool is walked forwards rather than at random
+		std::ranges::sort(sorted_, [](const Command& lhs, const Command& rhs)
+			{
+				return std::tie(lhs.op_, lhs.handle_.index_, lhs.components_) < std::tie(rhs.op_, rhs.handle_.index_, rhs.components_);
+			});
+
+		using ComponentOp = bool (Manager::*)(EntityHandle);
+		static constexpr std::array<ComponentOp, sizeof...(Components)> removers{ &Manager::template removeComponent<Components>... };
+		static constexpr std::array<ComponentOp, sizeof...(Components)> adders{ &Manager::template addComponent<Components>... };
+
+		std::size_t applied{ 0U };
+		auto first{ sorted_.cbegin() };
+		for (; first != sorted_.cend() && first->op_ == Op::remove; ++first)
+		{
+			applied += (entitiesManager_.*removers[first->components_])(first->handle_) ? 1U : 0U;
+		}
+		for (; first != sorted_.cend() && first->op_ == Op::add; ++first)
+		{
+			try
+			{
+				applied += (entitiesManager_.*adders[first->components_])(first->handle_) ? 1U : 0U;
+			}
+			catch (const components_max_capacity_exception&)
+			{
+				// the pool is full, the addition is skipped and the remaining commands are still applied
+			}
+		}
+
+		const auto spawns{ std::ranges::find_if(first, sorted_.cend(), [](const Command& command) { return command.op_ == Op::spawn; }) };
+		applied += applyDestroys({ first, spawns }, entities);
+		applied += applySpawns({ spawns, sorted_.cend() }, entities);
+
+		span.processed(applied);
+		return applied;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::size_t CommandBuffer<CAPACITY, Components...>::size() const noexcept
+	{
+		std::size_t count{ 0U };
+		for (const Queue& queue : queues_)
+		{
+			count += queue.commands_.size();
+		}
+		return count;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void CommandBuffer<CAPACITY, Components...>::record(const Command& command)
+	{
+		queues_[threadPool_.workerIndex()].commands_.push_back(command);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::size_t CommandBuffer<CAPACITY, Components...>::applyDestroys(std::span<const Command> destroys, std::vector<Entity>& entities) noexcept(false)
+	{
+		// sorted by slot already, an entity destroyed twice is released once
+		std::vector<std::uint32_t> doomed{};
+		doomed.reserve(destroys.size());
+		for (const Command& command : destroys)
+		{
+			if (entitiesManager_.isAlive(command.handle_) && (doomed.empty() || doomed.back() != command.handle_.index_))
+			{
+				doomed.push_back(command.handle_.index_);
+			}
+		}
+		if (doomed.empty())
+		{
+			return 0U;
+		}
+
+		// Entity can't be move assigned, hence the survivors are moved to a new vector
+		std::vector<Entity> kept{};
+		std::vector<Entity> released{};
+		kept.reserve(entities.size());
+		released.reserve(doomed.size());
+		for (Entity& ent : entities)
+		{
+			(std::ranges::binary_search(doomed, ent.getHandle().index_) ? released : kept).push_back(std::move(ent));
+		}
+		entities = std::move(kept);
+
+		const std::size_t releasedCount{ released.size() };
+		entitiesManager_.releaseEntities(std::move(released));
+		return releasedCount;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::size_t CommandBuffer<CAPACITY, Components...>::applySpawns(std::span<const Command> spawns, std::vector<Entity>& entities) noexcept(false)
+	{
+		using BatchOp = std::size_t (Manager::*)(std::span<Entity>);
+		static constexpr std::array<BatchOp, sizeof...(Components)> batchAdders{ &Manager::template addComponents<Components>... };
+
+		// spawns are sorted by their components, so every run of equal masks is requested as one batch
+		std::size_t applied{ 0U };
+		for (auto first{ spawns.begin() }; first != spawns.end();)
+		{
+			const std::uint64_t mask{ first->components_ };
+			const auto last{ std::find_if(first, spawns.end(), [mask](const Command& command) { return command.components_ != mask; }) };
+
+			std::vector<Entity> spawned{};
+			try
+			{
+				spawned = entitiesManager_.requestEntities(static_cast<std::size_t>(last - first));
+				for (std::uint64_t bits{ mask }; bits != 0U; bits &= bits - 1U)
+				{
+					static_cast<void>((entitiesManager_.*batchAdders[std::countr_zero(bits)])(spawned));
+				}
+			}
+			catch (const entities_max_capacity_exception&)
+			{
+				// not every entity of the run fits, the whole run is skipped
+				first = last;
+				continue;
+			}
+			catch (const components_max_capacity_exception&)
+			{
+				// the run's entities are released along with the components already attached to them
+				entitiesManager_.releaseEntities(std::move(spawned));
+				first = last;
+				continue;
+			}
+
+			applied += spawned.size();
+			entities.reserve(entities.size() + spawned.size());
+			for (Entity& ent : spawned)
+			{
+				entities.push_back(std::move(ent));
+			}
+			first = last;
+		}
+
+		return applied;
+	}
+}
+
+#endif // !COMMAND_BUFFER
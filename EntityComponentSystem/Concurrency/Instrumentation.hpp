@@ -0,0 +1,426 @@
+#ifndef INSTRUMENTATION
+#define INSTRUMENTATION
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// Opt-in: defining ECS_INSTRUMENTATION (e.g. with the ECS_INSTRUMENTATION CMake option) records how long every system takes,
+// how many entities it processed and how long threads waited on pool locks.
+// Without it every hook below is an empty inline function, so it compiles away entirely.
+// Only function bodies depend on it, the classes have the same layout either way
+namespace ecs::instrumentation
+{
+#if defined(ECS_INSTRUMENTATION)
+	inline constexpr bool enabled{ true };
+#else
+	inline constexpr bool enabled{ false };
+#endif
+
+	enum class EventKind : std::uint8_t
+	{
+		// a system's run, see SystemScope
+		system,
+		// a thread blocked on a contended pool lock, see timed_lock
+		lockWait,
+		// a chunk of a system split across threads, see parallel_for_chunks
+		chunk,
+		// a CommandBuffer's playback
+		commandFlush
+	};
+
+	struct Event
+	{
+		// the system's or the lock's name, a string literal. A chunk is named after its system
+		const char* name_;
+		EventKind kind_;
+		// the recording thread, numbered in the order threads first recorded
+		std::uint32_t thread_;
+		// the frame it began in, see end_frame
+		std::uint64_t frame_;
+		// steady_clock nanoseconds
+		std::int64_t beginNs_;
+		std::int64_t endNs_;
+		// entities a system processed, slots of a chunk, commands applied by a playback, 0 for lock waits
+		std::uint64_t entities_;
+	};
+
+	// A single producer single consumer ring of events: only its thread pushes, and drain_events pops.
+	// Pushing takes no lock, when the ring is full the event is dropped and counted instead
+	class EventRing
+	{
+	public:
+		static constexpr std::size_t capacity_s{ 4096U };
+
+		explicit EventRing(std::uint32_t thread) noexcept;
+
+		void push(const Event& event) noexcept;
+
+		// appends the events pushed so far to events.
+		// NOTE: mustn't be called concurrently with itself
+		void drainInto(std::vector<Event>& events) noexcept(false);
+
+		[[nodiscard]] std::uint32_t thread() const noexcept;
+
+		[[nodiscard]] std::uint64_t dropped() const noexcept;
+
+	private:
+		std::array<Event, capacity_s> events_;
+		const std::uint32_t thread_;
+		alignas(64) std::atomic<std::uint64_t> written_;
+		alignas(64) std::atomic<std::uint64_t> read_;
+		std::atomic<std::uint64_t> dropped_;
+	};
+
+	// per system totals over a frame
+	struct SystemStats
+	{
+		const char* name_;
+		std::size_t runs_;
+		std::chrono::nanoseconds wallTime_;
+		std::uint64_t entities_;
+	};
+
+	// per lock totals over a frame
+	struct LockStats
+	{
+		const char* name_;
+		std::size_t waits_;
+		std::chrono::nanoseconds waitTime_;
+	};
+
+	struct FrameStats
+	{
+		std::uint64_t frame_;
+		// in the order each system first ran
+		std::vector<SystemStats> systems_;
+		std::vector<LockStats> locks_;
+	};
+
+	// the number of frames ended so far, which is the current frame's number
+	[[nodiscard]] std::uint64_t current_frame() noexcept;
+
+	// moves on to the next frame, Scheduler::runFrame calls it after every frame
+	void end_frame() noexcept;
+
+	// moves every event recorded so far out of the threads' rings, sorted by the time they began.
+	// NOTE: mustn't be called concurrently with itself
+	[[nodiscard]] std::vector<Event> drain_events() noexcept(false);
+
+	// the events dropped so far because a thread's ring was full
+	[[nodiscard]] std::uint64_t dropped_events() noexcept;
+
+	// totals of the system and lock wait events of frame, e.g. frame_stats(drain_events(), current_frame() - 1U) after a frame.
+	// Events are grouped by the contents of their names, the same name spelled in several places is a single system or lock.
+	// Chunks and playbacks are left out, they're part of their systems or sit between them, see write_chrome_trace
+	[[nodiscard]] FrameStats frame_stats(std::span<const Event> events, std::uint64_t frame) noexcept(false);
+
+	// Records an event of the given kind, spanning its lifetime on the calling thread
+	class SpanScope
+	{
+	public:
+		SpanScope(EventKind kind, const char* name) noexcept;
+
+		SpanScope(const SpanScope&) = delete;
+		SpanScope& operator=(const SpanScope&) = delete;
+
+		~SpanScope();
+
+		void processed(std::uint64_t entities) noexcept;
+
+	private:
+		const char* name_;
+		EventKind kind_;
+		std::uint64_t frame_;
+		std::int64_t beginNs_;
+		std::uint64_t entities_;
+	};
+
+	// Times a system from construction to destruction, e.g.
+	// instrumentation::SystemScope scope{ "move_system" };
+	// scope.processed(pool.size());
+	// While it lives it's the calling thread's current_system()
+	class SystemScope : public SpanScope
+	{
+	public:
+		explicit SystemScope(const char* name) noexcept;
+
+		~SystemScope();
+
+	private:
+		const char* enclosing_;
+	};
+
+	// the name of the innermost SystemScope alive on the calling thread, nullptr if none is (or without ECS_INSTRUMENTATION)
+	[[nodiscard]] const char* current_system() noexcept;
+
+	// Locks mutex, and if it's contended records how long the calling thread waited as a lockWait event named name.
+	// An uncontended lock reads no clock
+	template <typename Mutex>
+	[[nodiscard]] std::lock_guard<Mutex> timed_lock(Mutex& mutex, const char* name);
+
+
+	namespace instrumentation_detail
+	{
+		inline thread_local const char* currentSystem{ nullptr };
+
+		[[nodiscard]] inline std::int64_t now_ns() noexcept
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		// owns every thread's ring, rings outlive their threads so their events can still be drained
+		class Registry
+		{
+		public:
+			[[nodiscard]] static Registry& instance() noexcept;
+
+			// the calling thread's ring, registered on its first event
+			[[nodiscard]] EventRing& ring() noexcept(false);
+
+			[[nodiscard]] std::vector<Event> drain() noexcept(false);
+
+			[[nodiscard]] std::uint64_t dropped() noexcept;
+
+			std::atomic<std::uint64_t> frame_{ 0U };
+
+		private:
+			std::mutex mutex_;
+			std::vector<std::unique_ptr<EventRing>> rings_;
+		};
+
+		inline Registry& Registry::instance() noexcept
+		{
+			static Registry registry{};
+			return registry;
+		}
+
+		inline EventRing& Registry::ring() noexcept(false)
+		{
+			thread_local EventRing* threadRing{ nullptr };
+			if (threadRing == nullptr)
+			{
+				std::lock_guard lock{ mutex_ };
+				rings_.push_back(std::make_unique<EventRing>(static_cast<std::uint32_t>(rings_.size())));
+				threadRing = rings_.back().get();
+			}
+			return *threadRing;
+		}
+
+		inline std::vector<Event> Registry::drain() noexcept(false)
+		{
+			std::vector<Event> events{};
+			{
+				std::lock_guard lock{ mutex_ };
+				for (const std::unique_ptr<EventRing>& ring : rings_)
+				{
+					ring->drainInto(events);
+				}
+			}
+
+			std::ranges::stable_sort(events, {}, &Event::beginNs_);
+			return events;
+		}
+
+		inline std::uint64_t Registry::dropped() noexcept
+		{
+			std::lock_guard lock{ mutex_ };
+			std::uint64_t count{ 0U };
+			for (const std::unique_ptr<EventRing>& ring : rings_)
+			{
+				count += ring->dropped();
+			}
+			return count;
+		}
+
+		inline void record(const Event& event) noexcept
+		{
+			// a thread which can't get a ring loses its events, like a full ring does
+			try
+			{
+				Registry::instance().ring().push(event);
+			}
+			catch (...)
+			{
+			}
+		}
+	}
+
+	inline EventRing::EventRing(std::uint32_t thread) noexcept
+		: events_{}
+		, thread_{ thread }
+		, written_{ 0U }
+		, read_{ 0U }
+		, dropped_{ 0U }
+	{ }
+
+	inline void EventRing::push(const Event& event) noexcept
+	{
+		const std::uint64_t written{ written_.load(std::memory_order_relaxed) };
+		if (written - read_.load(std::memory_order_acquire) == capacity_s)
+		{
+			dropped_.fetch_add(1U, std::memory_order_relaxed);
+			return;
+		}
+
+		events_[written % capacity_s] = event;
+		events_[written % capacity_s].thread_ = thread_;
+		written_.store(written + 1U, std::memory_order_release);
+	}
+
+	inline void EventRing::drainInto(std::vector<Event>& events) noexcept(false)
+	{
+		const std::uint64_t read{ read_.load(std::memory_order_relaxed) };
+		const std::uint64_t written{ written_.load(std::memory_order_acquire) };
+		for (std::uint64_t i{ read }; i != written; ++i)
+		{
+			events.push_back(events_[i % capacity_s]);
+		}
+		read_.store(written, std::memory_order_release);
+	}
+
+	inline std::uint32_t EventRing::thread() const noexcept
+	{
+		return thread_;
+	}
+
+	inline std::uint64_t EventRing::dropped() const noexcept
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+	inline std::uint64_t current_frame() noexcept
+	{
+		return instrumentation_detail::Registry::instance().frame_.load(std::memory_order_relaxed);
+	}
+
+	inline void end_frame() noexcept
+	{
+		if constexpr (enabled)
+		{
+			instrumentation_detail::Registry::instance().frame_.fetch_add(1U, std::memory_order_relaxed);
+		}
+	}
+
+	inline std::vector<Event> drain_events() noexcept(false)
+	{
+		return instrumentation_detail::Registry::instance().drain();
+	}
+
+	inline std::uint64_t dropped_events() noexcept
+	{
+		return instrumentation_detail::Registry::instance().dropped();
+	}
+
+	inline FrameStats frame_stats(std::span<const Event> events, std::uint64_t frame) noexcept(false)
+	{
+		FrameStats stats{ frame, {}, {} };
+		for (const Event& event : events)
+		{
+			if (event.frame_ != frame || event.kind_ == EventKind::chunk || event.kind_ == EventKind::commandFlush)
+			{
+				continue;
+			}
+
+			const std::chrono::nanoseconds duration{ event.endNs_ - event.beginNs_ };
+			if (event.kind_ == EventKind::system)
+			{
+				auto system{ std::ranges::find(stats.systems_, std::string_view{ event.name_ },
+					[](const SystemStats& stat) { return std::string_view{ stat.name_ }; }) };
+				if (system == stats.systems_.end())
+				{
+					system = stats.systems_.insert(system, SystemStats{ event.name_, 0U, std::chrono::nanoseconds{ 0 }, 0U });
+				}
+				++system->runs_;
+				system->wallTime_ += duration;
+				system->entities_ += event.entities_;
+			}
+			else
+			{
+				auto lock{ std::ranges::find(stats.locks_, std::string_view{ event.name_ },
+					[](const LockStats& stat) { return std::string_view{ stat.name_ }; }) };
+				if (lock == stats.locks_.end())
+				{
+					lock = stats.locks_.insert(lock, LockStats{ event.name_, 0U, std::chrono::nanoseconds{ 0 } });
+				}
+				++lock->waits_;
+				lock->waitTime_ += duration;
+			}
+		}
+		return stats;
+	}
+
+	inline SpanScope::SpanScope(EventKind kind, const char* name) noexcept
+		: name_{ name }
+		, kind_{ kind }
+		, frame_{ 0U }
+		, beginNs_{ 0 }
+		, entities_{ 0U }
+	{
+#if defined(ECS_INSTRUMENTATION)
+		frame_ = current_frame();
+		beginNs_ = instrumentation_detail::now_ns();
+#endif
+	}
+
+	inline SpanScope::~SpanScope()
+	{
+#if defined(ECS_INSTRUMENTATION)
+		instrumentation_detail::record(Event{ name_, kind_, 0U, frame_, beginNs_, instrumentation_detail::now_ns(), entities_ });
+#endif
+	}
+
+	inline void SpanScope::processed([[maybe_unused]] std::uint64_t entities) noexcept
+	{
+#if defined(ECS_INSTRUMENTATION)
+		entities_ += entities;
+#endif
+	}
+
+	inline SystemScope::SystemScope(const char* name) noexcept
+		: SpanScope{ EventKind::system, name }
+		, enclosing_{ instrumentation_detail::currentSystem }
+	{
+#if defined(ECS_INSTRUMENTATION)
+		instrumentation_detail::currentSystem = name;
+#endif
+	}
+
+	inline SystemScope::~SystemScope()
+	{
+#if defined(ECS_INSTRUMENTATION)
+		instrumentation_detail::currentSystem = enclosing_;
+#endif
+	}
+
+	inline const char* current_system() noexcept
+	{
+		return instrumentation_detail::currentSystem;
+	}
+
+	template <typename Mutex>
+	std::lock_guard<Mutex> timed_lock(Mutex& mutex, [[maybe_unused]] const char* name)
+	{
+#if defined(ECS_INSTRUMENTATION)
+		if (!mutex.try_lock())
+		{
+			const std::int64_t beginNs{ instrumentation_detail::now_ns() };
+			mutex.lock();
+			instrumentation_detail::record(Event{ name, EventKind::lockWait, 0U, current_frame(), beginNs, instrumentation_detail::now_ns(), 0U });
+		}
+		return std::lock_guard<Mutex>{ mutex, std::adopt_lock };
+#else
+		return std::lock_guard<Mutex>{ mutex };
+#endif
+	}
+}
+
+#endif // !INSTRUMENTATION
@@ -0,0 +1,67 @@
+#ifndef PARALLEL_FOR
+#define PARALLEL_FOR
+
+#include "ThreadPool.hpp"
+#include "ComponentPool.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+
+namespace ecs
+{
+	// slots [begin, end) of a pool
+	struct SlotChunk
+	{
+		std::size_t begin;
+		std::size_t end;
+	};
+
+	// 64 occupancy words, 16 KiB of a float column
+	inline constexpr std::size_t defaultChunkSlots{ 4096U };
+
+	// Splits slots [0, slotsCount) into chunks of chunkSlots (the last one may be shorter) and runs func(chunk)
+	// for every chunk on threadPool and the calling thread.
+	// Chunk boundaries only depend on slotsCount and chunkSlots, never on the number of threads.
+	// chunkSlots is rounded up to a multiple of 64, so no two chunks share an occupancy word, 
+	// and as long as the pool's storage is cache line aligned no two chunks write to the same cache line.
+	// Every chunk is recorded as a chunk event named after the calling thread's current system, see Instrumentation.hpp
+	template <typename Func>
+	void parallel_for_chunks(ThreadPool& threadPool, std::size_t slotsCount, std::size_t chunkSlots, Func&& func)
+	{
+		constexpr std::size_t wordSlots{ 64U };
+		chunkSlots = std::max((chunkSlots + wordSlots - 1U) / wordSlots * wordSlots, wordSlots);
+
+		const std::size_t chunksCount{ (slotsCount + chunkSlots - 1U) / chunkSlots };
+		const char* const system{ instrumentation::current_system() };
+		threadPool.parallelFor(chunksCount, [&func, slotsCount, chunkSlots, system](std::size_t chunkIdx)
+			{
+				const std::size_t begin{ chunkIdx * chunkSlots };
+				const SlotChunk chunk{ begin, std::min(begin + chunkSlots, slotsCount) };
+
+				instrumentation::SpanScope span{ instrumentation::EventKind::chunk, system != nullptr ? system : "parallel_for_chunks" };
+				span.processed(chunk.end - chunk.begin);
+				func(chunk);
+			});
+	}
+
+	// runs func(component) for every live component of an array-of-structs pool, split into chunks as above
+	template <ComponentConcept Component, std::size_t CAPACITY, typename Func>
+		requires (!SoaComponent<Component>)
+	void parallel_for_each(ThreadPool& threadPool, ComponentPool<Component, CAPACITY>& pool, Func&& func, 
+		std::size_t chunkSlots = defaultChunkSlots)
+	{
+		Component* const compos{ pool.begin() };
+		const OccupancyBitset<CAPACITY>& occupancy{ pool.occupancy() };
+
+		parallel_for_chunks(threadPool, CAPACITY, chunkSlots, [compos, &occupancy, &func](SlotChunk chunk)
+			{
+				const std::size_t endWord{ (chunk.end + OccupancyBitset<CAPACITY>::bitsPerWord - 1U) / OccupancyBitset<CAPACITY>::bitsPerWord };
+				for (const std::size_t slot : occupancy.slotsIn(chunk.begin / OccupancyBitset<CAPACITY>::bitsPerWord, endWord))
+				{
+					func(compos[slot]);
+				}
+			});
+	}
+}
+
+#endif // !PARALLEL_FOR
@@ -0,0 +1,266 @@
+#ifndef SCHEDULER
+#define SCHEDULER
+
+#include "ThreadPool.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace ecs
+{
+	// Stands for the entities pool: entity ids, groups and the handles to their components.
+	// Components stand for their own pools.
+	struct EntityBodies {};
+
+	namespace scheduler_detail
+	{
+		// a set of resources, bit id of word id / 64 stands for the resource numbered id.
+		// It grows with the highest id in it, so there's no limit on how many resources there are
+		using ResourceSet = std::vector<std::uint64_t>;
+
+		inline constexpr std::size_t bitsPerWord{ 64U };
+
+		inline std::size_t next_resource_id() noexcept
+		{
+			static std::atomic<std::size_t> nextId{ 0U };
+			return nextId.fetch_add(1U, std::memory_order_relaxed);
+		}
+
+		// every resource type gets its own number the first time it's named by a system
+		template <typename Resource>
+		std::size_t resource_id() noexcept
+		{
+			static const std::size_t id{ next_resource_id() };
+			return id;
+		}
+
+		inline void insert(ResourceSet& set, std::size_t id) noexcept(false)
+		{
+			if (set.size() <= id / bitsPerWord)
+			{
+				set.resize(id / bitsPerWord + 1U, 0U);
+			}
+			set[id / bitsPerWord] |= std::uint64_t{ 1U } << (id % bitsPerWord);
+		}
+
+		inline void unite(ResourceSet& set, const ResourceSet& other) noexcept(false)
+		{
+			if (set.size() < other.size())
+			{
+				set.resize(other.size(), 0U);
+			}
+			for (std::size_t i{ 0U }; i != other.size(); ++i)
+			{
+				set[i] |= other[i];
+			}
+		}
+
+		[[nodiscard]] inline bool intersect(const ResourceSet& lhs, const ResourceSet& rhs) noexcept
+		{
+			const std::size_t words{ std::min(lhs.size(), rhs.size()) };
+			for (std::size_t i{ 0U }; i != words; ++i)
+			{
+				if ((lhs[i] & rhs[i]) != 0U)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		template <typename... Resources>
+		[[nodiscard]] ResourceSet resource_set() noexcept(false)
+		{
+			ResourceSet set{};
+			(insert(set, resource_id<Resources>()), ...);
+			return set;
+		}
+	}
+
+	// the resources a system reads, e.g. Reads<LifetimeComponent, EntityBodies>
+	template <typename... Resources>
+	struct Reads
+	{
+		static scheduler_detail::ResourceSet set() noexcept(false)
+		{
+			return scheduler_detail::resource_set<Resources...>();
+		}
+	};
+
+	// the resources a system writes, writing implies reading
+	template <typename... Resources>
+	struct Writes
+	{
+		static scheduler_detail::ResourceSet set() noexcept(false)
+		{
+			return scheduler_detail::resource_set<Resources...>();
+		}
+	};
+
+
+	// Runs a set of systems once per frame on a ThreadPool.
+	// Two systems conflict if one of them writes a resource the other reads or writes.
+	// Conflicting systems run one after the other, in the order they were added,
+	// and all other systems may run in parallel.
+	// The dependency graph only changes when a system is added, so it's built once rather than every frame.
+	class Scheduler
+	{
+	public:
+		explicit Scheduler(ThreadPool& threadPool);
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+
+		template <typename ReadSet, typename WriteSet, typename System>
+		void addSystem(System&& system) noexcept(false);
+
+		// runs every system once and returns when all of them are done.
+		// If systems throw, the rest of the frame still runs and the first exception is rethrown here.
+		// Ends the frame for instrumentation as well, see instrumentation::end_frame
+		void runFrame() noexcept(false);
+
+		[[nodiscard]] std::size_t systemsCount() const noexcept;
+
+	private:
+		struct Node
+		{
+			std::function<void()> system_;
+			scheduler_detail::ResourceSet reads_;
+			scheduler_detail::ResourceSet writes_;
+			std::vector<std::size_t> dependents_;
+			std::size_t dependenciesCount_;
+		};
+
+		ThreadPool& threadPool_;
+		std::vector<Node> nodes_;
+
+		// state of the running frame
+		std::unique_ptr<std::atomic<std::size_t>[]> pending_;
+		std::size_t pendingCapacity_;
+		std::atomic<std::size_t> finished_;
+		std::mutex errorMutex_;
+		std::exception_ptr error_;
+
+		// runs node idx, then the dependents it was the last dependency of
+		void run(std::size_t idx);
+	};
+
+
+	inline Scheduler::Scheduler(ThreadPool& threadPool)
+		: threadPool_{ threadPool }
+		, nodes_{}
+		, pending_{}
+		, pendingCapacity_{ 0U }
+		, finished_{ 0U }
+		, errorMutex_{}
+		, error_{}
+	{
+	}
+
+	template <typename ReadSet, typename WriteSet, typename System>
+	void Scheduler::addSystem(System&& system) noexcept(false)
+	{
+		scheduler_detail::ResourceSet writes{ WriteSet::set() };
+		scheduler_detail::ResourceSet reads{ ReadSet::set() };
+		scheduler_detail::unite(reads, writes);
+
+		const std::size_t idx{ nodes_.size() };
+		std::size_t dependenciesCount{ 0U };
+		for (Node& earlier : nodes_)
+		{
+			if (scheduler_detail::intersect(earlier.writes_, reads) || scheduler_detail::intersect(writes, earlier.reads_))
+			{
+				earlier.dependents_.push_back(idx);
+				++dependenciesCount;
+			}
+		}
+
+		nodes_.push_back(Node{ std::function<void()>{ std::forward<System>(system) }, std::move(reads), std::move(writes), {}, dependenciesCount });
+	}
+
+	inline void Scheduler::runFrame() noexcept(false)
+	{
+		if (pendingCapacity_ < nodes_.size())
+		{
+			pending_ = std::make_unique<std::atomic<std::size_t>[]>(nodes_.size());
+			pendingCapacity_ = nodes_.size();
+		}
+		for (std::size_t i{ 0U }; i != nodes_.size(); ++i)
+		{
+			pending_[i].store(nodes_[i].dependenciesCount_, std::memory_order_relaxed);
+		}
+		finished_.store(0U, std::memory_order_relaxed);
+		error_ = nullptr;
+
+		for (std::size_t i{ 0U }; i != nodes_.size(); ++i)
+		{
+			if (nodes_[i].dependenciesCount_ == 0U)
+			{
+				threadPool_.submit([this, i]() { run(i); });
+			}
+		}
+
+		// the calling thread runs systems too, so a frame completes even without workers
+		threadPool_.runUntil([this]() { return finished_.load(std::memory_order_acquire) == nodes_.size(); });
+		instrumentation::end_frame();
+
+		if (error_)
+		{
+			std::rethrow_exception(error_);
+		}
+	}
+
+	inline std::size_t Scheduler::systemsCount() const noexcept
+	{
+		return nodes_.size();
+	}
+
+	inline void Scheduler::run(std::size_t idx)
+	{
+		const std::size_t none{ nodes_.size() };
+		while (idx != none)
+		{
+			try
+			{
+				nodes_[idx].system_();
+			}
+			catch (...)
+			{
+				std::lock_guard lock{ errorMutex_ };
+				if (!error_)
+				{
+					error_ = std::current_exception();
+				}
+			}
+
+			// the dependent released last runs next on this thread rather than through the pool
+			std::size_t next{ none };
+			for (const std::size_t dependent : nodes_[idx].dependents_)
+			{
+				if (pending_[dependent].fetch_sub(1U, std::memory_order_acq_rel) == 1U)
+				{
+					if (next != none)
+					{
+						threadPool_.submit([this, next]() { run(next); });
+					}
+					next = dependent;
+				}
+			}
+
+			// runFrame may return as soon as the last system is counted, so nothing of this is touched afterwards
+			finished_.fetch_add(1U, std::memory_order_release);
+			idx = next;
+		}
+	}
+}
+
+#endif // !SCHEDULER
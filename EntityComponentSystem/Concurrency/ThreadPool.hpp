@@ -0,0 +1,288 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ecs
+{
+	// A fixed set of worker threads, created once and reused across frames.
+	// Every worker owns a deque of tasks: it pushes and pops its own tasks at the back,
+	// and when it runs dry it steals from the front of the others' deques.
+	// Tasks submitted from outside the pool go to one extra deque, which every worker steals from.
+	// An idle worker spins for a short while before going to sleep,
+	// so a frame which submits work shortly after the previous one doesn't pay for waking threads up.
+	class ThreadPool
+	{
+	public:
+		// the calling thread takes part in parallelFor and runUntil, hence one worker less than the hardware threads by default
+		explicit ThreadPool(std::size_t workersCount = std::max(std::thread::hardware_concurrency(), 1U) - 1U);
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		~ThreadPool();
+
+		// a task submitted from a worker goes to the back of that worker's deque, so it runs next on the same core unless stolen
+		void submit(std::function<void()> task);
+
+		// runs queued tasks on the calling thread until done() returns true.
+		// NOTE: done is polled, it should be cheap
+		template <typename Pred>
+		void runUntil(Pred&& done);
+
+		// runs func(i) for every i in [0, count) on the workers and the calling thread,
+		// and returns once all of them are done.
+		// NOTE: func mustn't throw
+		template <typename Func>
+		void parallelFor(std::size_t count, Func&& func);
+
+		[[nodiscard]] std::size_t workersCount() const noexcept;
+
+		// the calling worker's index in [0, workersCount()), workersCount() for any thread outside this pool
+		[[nodiscard]] std::size_t workerIndex() const noexcept;
+
+	private:
+		struct alignas(64) TaskDeque
+		{
+			std::mutex mutex_;
+			std::deque<std::function<void()>> tasks_;
+		};
+
+		// how long an idle worker keeps looking for tasks before it sleeps
+		static constexpr std::chrono::microseconds spinDuration_s{ 50 };
+
+		// workersCount + 1 deques, the last one takes tasks submitted from outside
+		std::vector<std::unique_ptr<TaskDeque>> deques_;
+		std::vector<std::thread> workers_;
+
+		// tasks submitted but not yet taken from a deque
+		std::atomic<std::size_t> queuedCount_;
+
+		std::mutex sleepMutex_;
+		std::condition_variable sleepCv_;
+		std::atomic<std::size_t> sleepersCount_;
+		std::atomic<bool> stopping_;
+
+		// pops a task from the back of deque idx, or else steals one from the front of another deque
+		bool tryRunOne(std::size_t idx);
+
+		void work(std::size_t idx);
+	};
+
+
+	namespace thread_pool_detail
+	{
+		struct WorkerIdentity
+		{
+			const void* pool;
+			std::size_t idx;
+		};
+
+		inline thread_local WorkerIdentity currentWorker{ nullptr, 0U };
+	}
+
+	inline ThreadPool::ThreadPool(std::size_t workersCount)
+		: deques_{}
+		, workers_{}
+		, queuedCount_{ 0U }
+		, sleepMutex_{}
+		, sleepCv_{}
+		, sleepersCount_{ 0U }
+		, stopping_{ false }
+	{
+		deques_.reserve(workersCount + 1U);
+		for (std::size_t i{ 0U }; i != workersCount + 1U; ++i)
+		{
+			deques_.push_back(std::make_unique<TaskDeque>());
+		}
+
+		workers_.reserve(workersCount);
+		for (std::size_t i{ 0U }; i != workersCount; ++i)
+		{
+			workers_.emplace_back(&ThreadPool::work, this, i);
+		}
+	}
+
+	inline ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard lock{ sleepMutex_ };
+			stopping_.store(true);
+		}
+		sleepCv_.notify_all();
+
+		for (std::thread& worker : workers_)
+		{
+			worker.join();
+		}
+	}
+
+	inline void ThreadPool::submit(std::function<void()> task)
+	{
+		// counted before it's pushed, so queuedCount_ never drops below the tasks in the deques.
+		// Pairs with a sleeper registering itself before it checks queuedCount_ one last time
+		queuedCount_.fetch_add(1U, std::memory_order_seq_cst);
+
+		TaskDeque& deque{ *deques_[workerIndex()] };
+		{
+			std::lock_guard lock{ deque.mutex_ };
+			deque.tasks_.push_back(std::move(task));
+		}
+
+		if (sleepersCount_.load(std::memory_order_seq_cst) != 0U)
+		{
+			std::lock_guard lock{ sleepMutex_ };
+			sleepCv_.notify_one();
+		}
+	}
+
+	template <typename Pred>
+	void ThreadPool::runUntil(Pred&& done)
+	{
+		// the deque of the calling thread, the shared one for threads outside this pool
+		const std::size_t own{ workerIndex() };
+		while (!done())
+		{
+			if (!tryRunOne(own))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	template <typename Func>
+	void ThreadPool::parallelFor(std::size_t count, Func&& func)
+	{
+		// indices are claimed dynamically, so which thread runs func(i) may vary between calls,
+		// but every index runs exactly once
+		struct Shared
+		{
+			std::atomic<std::size_t> next{ 0U };
+			std::atomic<std::size_t> helpersRunning{ 0U };
+		} shared{};
+
+		auto drain = [&shared, &func, count]()
+		{
+			for (std::size_t i{ shared.next.fetch_add(1U, std::memory_order_relaxed) }; i < count;
+				i = shared.next.fetch_add(1U, std::memory_order_relaxed))
+			{
+				func(i);
+			}
+		};
+
+		const std::size_t helpersCount{ std::min(workers_.size(), count > 0U ? count - 1U : 0U) };
+		shared.helpersRunning.store(helpersCount, std::memory_order_relaxed);
+		for (std::size_t h{ 0U }; h != helpersCount; ++h)
+		{
+			submit([&shared, &drain]()
+				{
+					drain();
+					shared.helpersRunning.fetch_sub(1U, std::memory_order_release);
+				});
+		}
+
+		drain();
+
+		// helpers which didn't start yet are run or stolen here, so this never waits on a busy worker
+		runUntil([&shared]() { return shared.helpersRunning.load(std::memory_order_acquire) == 0U; });
+	}
+
+	inline std::size_t ThreadPool::workersCount() const noexcept
+	{
+		return workers_.size();
+	}
+
+	inline std::size_t ThreadPool::workerIndex() const noexcept
+	{
+		const thread_pool_detail::WorkerIdentity& worker{ thread_pool_detail::currentWorker };
+		return worker.pool == this ? worker.idx : workers_.size();
+	}
+
+	inline bool ThreadPool::tryRunOne(std::size_t idx)
+	{
+		if (queuedCount_.load(std::memory_order_acquire) == 0U)
+		{
+			return false;
+		}
+
+		std::function<void()> task{};
+		{
+			TaskDeque& own{ *deques_[idx] };
+			std::lock_guard lock{ own.mutex_ };
+			if (!own.tasks_.empty())
+			{
+				task = std::move(own.tasks_.back());
+				own.tasks_.pop_back();
+			}
+		}
+
+		for (std::size_t offset{ 1U }; !task && offset != deques_.size(); ++offset)
+		{
+			TaskDeque& victim{ *deques_[(idx + offset) % deques_.size()] };
+			std::lock_guard lock{ victim.mutex_ };
+			if (!victim.tasks_.empty())
+			{
+				task = std::move(victim.tasks_.front());
+				victim.tasks_.pop_front();
+			}
+		}
+
+		if (!task)
+		{
+			return false;
+		}
+
+		queuedCount_.fetch_sub(1U, std::memory_order_relaxed);
+		task();
+		return true;
+	}
+
+	inline void ThreadPool::work(std::size_t idx)
+	{
+		thread_pool_detail::currentWorker = { this, idx };
+
+		for (;;)
+		{
+			if (tryRunOne(idx))
+			{
+				continue;
+			}
+
+			// tasks queued before the destruction still run
+			if (stopping_.load(std::memory_order_acquire))
+			{
+				return;
+			}
+
+			const auto spinEnd{ std::chrono::steady_clock::now() + spinDuration_s };
+			while (queuedCount_.load(std::memory_order_acquire) == 0U && std::chrono::steady_clock::now() < spinEnd)
+			{
+				std::this_thread::yield();
+			}
+			if (queuedCount_.load(std::memory_order_acquire) != 0U)
+			{
+				continue;
+			}
+
+			std::unique_lock lock{ sleepMutex_ };
+			sleepersCount_.fetch_add(1U, std::memory_order_seq_cst);
+			sleepCv_.wait(lock, [this]()
+				{
+					return stopping_.load(std::memory_order_seq_cst) || queuedCount_.load(std::memory_order_seq_cst) != 0U;
+				});
+			sleepersCount_.fetch_sub(1U, std::memory_order_relaxed);
+		}
+	}
+}
+
+#endif // !THREAD_POOL
@@ -3,35 +3,123 @@
 
 #include "EntitiesPool.hpp"
 
-#include <typeinfo>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <tuple>
+#include <variant>
 #include <algorithm>
 
 
 namespace ecs
 {
-	template <std::size_t CAPACITY>
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	class EntitiesManager;
+
+	// Components are the component types entities of this manager may hold, each one gets its own pool.
+	// e.g. EntitiesManager<1024U, PhysicsComponent, LifetimeComponent>
+	template <std::size_t CAPACITY, ComponentConcept... Components>
 	class EntitiesManager
 	{
+		static_assert(((count_of<Components, Components...> == 1U) && ...), "every component type may be registered only once");
+
 	public:
 		class Entity;
 
+		EntitiesManager() noexcept;
+
+		EntitiesManager(const EntitiesManager&) = delete;
+		EntitiesManager& operator=(const EntitiesManager&) = delete;
+
 		[[nodiscard]] Entity requestEntity() noexcept(false);
 
+		// allocates count entities and attaches Attached to all of them,
+		// each pool is visited once for the whole batch
+		template <ComponentConcept... Attached>
+		[[nodiscard]] std::vector<Entity> requestEntities(std::size_t count) noexcept(false);
+
+		// attaches Attached to every entity which doesn't have them yet,
+		// either all components are attached or none (and it throws).
+		// returns the number of components attached
+		template <ComponentConcept... Attached>
+		std::size_t addComponents(std::span<Entity> entities) noexcept(false);
+
+		// releases the entities and their components, each pool is visited once for the whole batch
+		void releaseEntities(std::vector<Entity>&& entities) noexcept;
+
 		[[nodiscard]] bool isFull() const noexcept;
 
+		[[nodiscard]] std::size_t size() const noexcept;
+
+		// for systems, see 'Systems'
+		template <ComponentConcept Component>
+		[[nodiscard]] ComponentPool<Component, CAPACITY>& componentPool() noexcept;
+
+		[[nodiscard]] EntitiesPool<CAPACITY, Components...>& entitiesPool() noexcept;
+
+		[[nodiscard]] bool isAlive(EntityHandle handle) const noexcept;
+
+		// the handle's Component, nullptr if the entity was released or doesn't hold one
+		template <ComponentConcept Component>
+		[[nodiscard]] typename ComponentPool<Component, CAPACITY>::pointer componentOf(EntityHandle handle) noexcept;
+
+		// the entity a live component is attached to, EntityHandle{} if it isn't attached to any
+		template <ComponentConcept Component>
+		[[nodiscard]] EntityHandle ownerOf(typename ComponentPool<Component, CAPACITY>::pointer compo) noexcept;
+
+		// a range over the live components of an array-of-structs pool, in slot order,
+		// yielding std::pair<EntityHandle, Component&> with the entity each one is attached to (EntityHandle{} if none).
+		// NOTE: mustn't be iterated while components are requested or released
+		template <ComponentConcept Component>
+		[[nodiscard]] auto owned() noexcept requires (!SoaComponent<Component>);
+
+		// same as Entity::addComponent and Entity::removeComponent, false for a released entity as well
+		template <ComponentConcept Component>
+		[[nodiscard]] bool addComponent(EntityHandle handle) noexcept(false);
+
+		template <ComponentConcept Component>
+		[[nodiscard]] bool removeComponent(EntityHandle handle) noexcept;
+
+		template <ComponentConcept... Queried>
+		class View;
+
+		// the entities holding all of Queried, e.g. view<PhysicsComponent, LifetimeComponent>().with(Group::movers)
+		template <ComponentConcept... Queried>
+		[[nodiscard]] View<Queried...> view() noexcept;
+
+		// writes the whole manager, every entity with its components and groups and the free slots of every pool,
+		// in the binary format of Snapshot.hpp.
+		// NOTE: mustn't be called while entities or components are requested, released or changed
+		void save(std::ostream& out) const noexcept(false);
+
+		// restores a snapshot saved by a manager of the same CAPACITY and Components into this freshly constructed one,
+		// returning its entities in slot order. Ids, handles and groups are kept as they were saved,
+		// and every pool goes on to hand out the slots the saved manager would have.
+		// Throws snapshot_exception if the snapshot is malformed or was saved by another kind of manager,
+		// the manager should be discarded then
+		[[nodiscard]] std::vector<Entity> load(std::istream& in) noexcept(false);
+
 		class Entity
 		{
 		public:
 			[[nodiscard]] EntityId getId() const noexcept;
 
+			[[nodiscard]] EntityHandle getHandle() const noexcept;
+
 			template <ComponentConcept Component>
 			[[nodiscard]] bool hasComponent() const noexcept;
 
 			template <ComponentConcept Component>
-			[[nodiscard]] PooledVariant<CAPACITY>& getComponent() noexcept;
+			[[nodiscard]] PooledVariant<CAPACITY, Components...>& getComponent() noexcept;
 
+			// false if the entity holds one already,
+			// throws components_max_capacity_exception if Component's pool is full, the entity is left untouched then
 			template <ComponentConcept Component>
-			[[nodiscard]] bool addComponent() noexcept;
+			[[nodiscard]] bool addComponent() noexcept(false);
 
 			template <ComponentConcept Component>
 			[[nodiscard]] bool removeComponent() noexcept;
@@ -44,208 +132,703 @@ namespace ecs
 
 
 		private:
-			friend EntitiesManager<CAPACITY>;
+			friend EntitiesManager<CAPACITY, Components...>;
 
 			EntitiesManager& entitiesManager_;
-			PooledEntityBody<CAPACITY> pooledEntity_;
+			PooledEntityBody<CAPACITY, Components...> pooledEntity_;
 
 			explicit Entity(EntitiesManager& entitiesManager);
+
+			Entity(EntitiesManager& entitiesManager, PooledEntityBody<CAPACITY, Components...>&& pooledEntity) noexcept;
 		};
 
 
 	private:
-		// systems
-		friend void move_system<CAPACITY>(EntitiesManager<CAPACITY>& entitiesManager);
-		friend void decrease_lifetime_system<CAPACITY>(EntitiesManager<CAPACITY>& entitiesManager);
-		friend void dummy_system<CAPACITY>(EntitiesManager<CAPACITY>& entitiesManager);
+		static std::atomic<EntityId> nextId_s;
+
+		std::tuple<ComponentPool<Components, CAPACITY>...> componentPools_;
+
+		EntitiesPool<CAPACITY, Components...> entitiesPool_;
+
+		template <ComponentConcept Component>
+		void setOwner(const PooledComponent<Component, CAPACITY>& compo, const EntityBody<CAPACITY, Components...>* entBody) noexcept;
+
+		// the handle of the entity body at bodySlot, EntityHandle{} for noOwner
+		[[nodiscard]] EntityHandle ownerAt(std::uint32_t bodySlot) noexcept;
+
+		template <ComponentConcept Component>
+		[[nodiscard]] bool attach(EntityBody<CAPACITY, Components...>* entBody) noexcept(false);
+
+		template <ComponentConcept Component>
+		[[nodiscard]] static bool detach(EntityBody<CAPACITY, Components...>* entBody) noexcept;
+
+		template <ComponentConcept Component>
+		[[nodiscard]] static std::size_t countLacking(std::span<Entity> entities) noexcept;
+
+		template <ComponentConcept Component>
+		void attachBatch(std::span<Entity> entities, std::vector<PooledComponent<Component, CAPACITY>>& compos) noexcept;
+
+		template <ComponentConcept Component>
+		void releaseComponents(std::span<Entity> entities) noexcept;
+
+		// what a snapshot records of each component type, so a snapshot of another manager is refused
+		template <ComponentConcept Component>
+		[[nodiscard]] static constexpr std::array<std::uint64_t, 3U> layoutOf() noexcept;
 
-		static EntityId nextId_s;
+		// the pool, then the entity body slot each of its live components is attached to, in slot order
+		template <ComponentConcept Component>
+		void saveComponents(std::ostream& out) const noexcept(false);
 
-		
+		// the entities pool must be loaded already
+		template <ComponentConcept Component>
+		void loadComponents(std::istream& in) noexcept(false);
+	};
+
+
+	// Iterates the entities holding all of Queried, and enrolled to every group given to with(),
+	// yielding a tuple with a reference to each of their Queried components:
+	// Component& for array-of-structs components and SoaReference for structure-of-arrays ones, both used through '.'.
+	// Only the live slots of the smallest Queried pool are walked, the rest is checked on each slot's owning entity,
+	// so the cost follows the rarest component rather than the number of entities
+	// (unless that pool holds at least half as many components as there are entities, then the entities are walked).
+	// An iterator copies what it needs from its view, so it may outlive it: mgr.view<...>().with(...).begin() is fine.
+	// NOTE: mustn't be iterated while entities or components are requested or released
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	class EntitiesManager<CAPACITY, Components...>::View
+	{
+		static_assert(sizeof...(Queried) != 0U, "a view needs at least one component to drive it");
+
+	public:
+		using value_type = std::tuple<typename ComponentPool<Queried, CAPACITY>::reference...>;
+
+		class Iterator
+		{
+		public:
+			using value_type = View::value_type;
+			using difference_type = std::ptrdiff_t;
+
+			Iterator() noexcept = default;
+
+			// owners maps the driver's slots to entity body slots, nullptr if the driver is the entities pool itself
+			Iterator(EntityBody<CAPACITY, Components...>* entBodies, GroupMask groups,
+				const OccupancyBitset<CAPACITY>& driver, const std::array<std::uint32_t, CAPACITY>* owners) noexcept;
+
+			[[nodiscard]] value_type operator*() const noexcept;
+
+			Iterator& operator++() noexcept;
+
+			void operator++(int) noexcept;
+
+			[[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept;
+
+		private:
+			EntityBody<CAPACITY, Components...>* entBodies_{ nullptr };
+			GroupMask groups_{ 0U };
+			const std::array<std::uint32_t, CAPACITY>* owners_{ nullptr };
+			typename OccupancyBitset<CAPACITY>::Iterator slots_{};
+			EntityBody<CAPACITY, Components...>* entBody_{ nullptr };
+
+			// moves to the first slot from the current one whose entity matches
+			void settle() noexcept;
+		};
+
+		explicit View(EntitiesManager& entitiesManager) noexcept;
+
+		// only entities which are members of group as well
+		[[nodiscard]] View with(Group group) const noexcept;
 
-		ComponentPool<PhysicsComponent, CAPACITY> physicsComponentsPool_;
-		ComponentPool<LifetimeComponent, CAPACITY> lifetimeComponentsPool_;
+		[[nodiscard]] Iterator begin() const noexcept;
 
-		EntitiesPool<CAPACITY> entitiesPool_;
+		[[nodiscard]] std::default_sentinel_t end() const noexcept;
 
-		std::mutex mu_;
+	private:
+		EntitiesManager* entitiesManager_;
+		GroupMask groups_;
+
+		[[nodiscard]] static bool matches(const EntityBody<CAPACITY, Components...>& entBody, GroupMask groups) noexcept;
 	};
 
 
 	//////// EntitiesManager definitions //////// 
-	template <std::size_t CAPACITY>
-	EntityId EntitiesManager<CAPACITY>::nextId_s{ 0U };
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::atomic<EntityId> EntitiesManager<CAPACITY, Components...>::nextId_s{ 0U };
+
+	// user provided, so value initializing a manager (e.g. std::make_unique) doesn't zero all of its pools first,
+	// each pool touches a slot's pages only once it hands the slot out
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntitiesManager<CAPACITY, Components...>::EntitiesManager() noexcept
+		: componentPools_{}
+		, entitiesPool_{}
+	{ }
 
-	template <std::size_t CAPACITY>
-	EntitiesManager<CAPACITY>::Entity EntitiesManager<CAPACITY>::requestEntity() noexcept(false)
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntitiesManager<CAPACITY, Components...>::Entity EntitiesManager<CAPACITY, Components...>::requestEntity() noexcept(false)
 	{
-		std::lock_guard lock{ mu_ };
-
+		// the entities pool synchronizes itself, only the id counter is shared here
 		Entity ent{ *this };
-		ent.pooledEntity_->id_ = EntitiesManager<CAPACITY>::nextId_s++;
+		ent.pooledEntity_->id_ = EntitiesManager<CAPACITY, Components...>::nextId_s.fetch_add(1U, std::memory_order_relaxed);
 		return ent;
 	}
 
-	template <std::size_t CAPACITY>
-	bool EntitiesManager<CAPACITY>::isFull() const noexcept
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Attached>
+	std::vector<typename EntitiesManager<CAPACITY, Components...>::Entity> EntitiesManager<CAPACITY, Components...>::requestEntities(std::size_t count) noexcept(false)
 	{
-		return entitiesPool_.isFull();
+		std::vector<PooledEntityBody<CAPACITY, Components...>> entBodies{ entitiesPool_.requestBatch(count) };
+
+		EntityId id{ EntitiesManager<CAPACITY, Components...>::nextId_s.fetch_add(count, std::memory_order_relaxed) };
+
+		std::vector<Entity> entities{};
+		entities.reserve(count);
+		for (PooledEntityBody<CAPACITY, Components...>& entBody : entBodies)
+		{
+			entBody->id_ = id++;
+			entities.push_back(Entity{ *this, std::move(entBody) });
+		}
+
+		if constexpr (sizeof...(Attached) != 0U)
+		{
+			// if it throws the entities are released as the vector goes out of scope
+			static_cast<void>(addComponents<Attached...>(entities));
+		}
+
+		return entities;
 	}
 
-	//////// Entity definitions //////// 
-	template <std::size_t CAPACITY>
-	EntityId EntitiesManager<CAPACITY>::Entity::getId() const noexcept
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Attached>
+	std::size_t EntitiesManager<CAPACITY, Components...>::addComponents(std::span<Entity> entities) noexcept(false)
 	{
-		return pooledEntity_->id_;
-	}
+		// request every batch before attaching anything, so if a pool runs out 
+		// the already requested batches are released and the entities are left untouched
+		std::tuple<std::vector<PooledComponent<Attached, CAPACITY>>...> batches{
+			componentPool<Attached>().requestBatch(countLacking<Attached>(entities))... };
 
-	template <std::size_t CAPACITY>
-	EntitiesManager<CAPACITY>::Entity::Entity(EntitiesManager& entitiesManager)
-		: entitiesManager_{ entitiesManager }
-		, pooledEntity_{ entitiesManager_.entitiesPool_.request() }
-	{ }
+		std::size_t attached{ 0U };
+		((attached += std::get<std::vector<PooledComponent<Attached, CAPACITY>>>(batches).size(),
+			attachBatch<Attached>(entities, std::get<std::vector<PooledComponent<Attached, CAPACITY>>>(batches))), ...);
 
-	template <std::size_t CAPACITY>
-	template <ComponentConcept Component>
-	bool EntitiesManager<CAPACITY>::Entity::hasComponent() const noexcept
+		return attached;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void EntitiesManager<CAPACITY, Components...>::releaseEntities(std::vector<Entity>&& entities) noexcept
 	{
-		for (const PooledVariant<CAPACITY>& component : pooledEntity_->components_)
+		(releaseComponents<Components>(entities), ...);
+
+		std::vector<PooledEntityBody<CAPACITY, Components...>> entBodies{};
+		entBodies.reserve(entities.size());
+		for (Entity& ent : entities)
 		{
-			if (std::holds_alternative<PooledComponent<Component, CAPACITY>>(component))
-			{
-				return true;
-			}
+			entBodies.push_back(std::move(ent.pooledEntity_));
 		}
+		entities.clear();
 
-		return false;
+		entitiesPool_.releaseBatch(entBodies);
 	}
 
-	template <std::size_t CAPACITY>
+	template <std::size_t CAPACITY, ComponentConcept... Components>
 	template <ComponentConcept Component>
-	PooledVariant<CAPACITY>& EntitiesManager<CAPACITY>::Entity::getComponent() noexcept
+	ComponentPool<Component, CAPACITY>& EntitiesManager<CAPACITY, Components...>::componentPool() noexcept
 	{
-		// notice that due to EntityBody's definition if the wanted component isn't contained,
-		// then its alternative is a std::monostate
+		static_assert(same_as_any_of<Component, Components...>, "component isn't registered with this EntitiesManager");
+		return std::get<ComponentPool<Component, CAPACITY>>(componentPools_);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntitiesPool<CAPACITY, Components...>& EntitiesManager<CAPACITY, Components...>::entitiesPool() noexcept
+	{
+		return entitiesPool_;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	bool EntitiesManager<CAPACITY, Components...>::isAlive(EntityHandle handle) const noexcept
+	{
+		return entitiesPool_.isAlive(handle);
+	}
 
-		std::size_t firstEmpty{ componentClassesCount<CAPACITY> };
-		for (std::size_t i{ 0U }; i != componentClassesCount<CAPACITY>; ++i)
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	typename ComponentPool<Component, CAPACITY>::pointer EntitiesManager<CAPACITY, Components...>::componentOf(EntityHandle handle) noexcept
+	{
+		EntityBody<CAPACITY, Components...>* entBody{ entitiesPool_.get(handle) };
+		if (entBody == nullptr)
 		{
-			if (std::holds_alternative<PooledComponent<Component, CAPACITY>>(pooledEntity_->components_[i]))
-			{
-				return pooledEntity_->components_[i];
-			}
-			else if (firstEmpty == componentClassesCount<CAPACITY> &&
-				std::holds_alternative<std::monostate>(pooledEntity_->components_[i]))
-			{
-				firstEmpty = i;
-			}
+			return nullptr;
 		}
 
-		return pooledEntity_->components_[firstEmpty];
+		PooledVariant<CAPACITY, Components...>& compoVar{ entBody->components_[componentSlot<Component, Components...>] };
+		return std::holds_alternative<PooledComponent<Component, CAPACITY>>(compoVar) ? 
+			std::get<PooledComponent<Component, CAPACITY>>(compoVar).get() : nullptr;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	EntityHandle EntitiesManager<CAPACITY, Components...>::ownerOf(typename ComponentPool<Component, CAPACITY>::pointer compo) noexcept
+	{
+		const ComponentPool<Component, CAPACITY>& pool{ componentPool<Component>() };
+		const std::size_t slot{ pool.slotOf(compo) };
+		assert(pool.occupancy().test(slot) && "ownerOf: the component was released");
+
+		// released slots hold noOwner as well, so this stays safe when asserts are compiled out
+		return ownerAt(pool.owners()[slot]);
 	}
 
-	template <std::size_t CAPACITY>
+	template <std::size_t CAPACITY, ComponentConcept... Components>
 	template <ComponentConcept Component>
-	bool EntitiesManager<CAPACITY>::Entity::addComponent() noexcept
+	auto EntitiesManager<CAPACITY, Components...>::owned() noexcept requires (!SoaComponent<Component>)
 	{
-		std::size_t firstEmpty{ componentClassesCount<CAPACITY> };
-		for (std::size_t i{ 0U }; i != componentClassesCount<CAPACITY>; ++i)
+		ComponentPool<Component, CAPACITY>& pool{ componentPool<Component>() };
+		const std::array<std::uint32_t, CAPACITY>& owners{ pool.owners() };
+
+		return std::ranges::subrange{ pool.occupancy().begin(), pool.occupancy().end() } |
+			std::views::transform([this, compos = pool.begin(), &owners](std::size_t slot)
+				{
+					return std::pair<EntityHandle, Component&>{ ownerAt(owners[slot]), compos[slot] };
+				});
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::addComponent(EntityHandle handle) noexcept(false)
+	{
+		EntityBody<CAPACITY, Components...>* entBody{ entitiesPool_.get(handle) };
+		return entBody != nullptr && attach<Component>(entBody);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::removeComponent(EntityHandle handle) noexcept
+	{
+		EntityBody<CAPACITY, Components...>* entBody{ entitiesPool_.get(handle) };
+		return entBody != nullptr && detach<Component>(entBody);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::attach(EntityBody<CAPACITY, Components...>* entBody) noexcept(false)
+	{
+		PooledVariant<CAPACITY, Components...>& compoVar{ entBody->components_[componentSlot<Component, Components...>] };
+		if (!std::holds_alternative<std::monostate>(compoVar))
 		{
-			if (std::holds_alternative<PooledComponent<Component, CAPACITY>>(pooledEntity_->components_[i]))
-			{
-				return false;
-			}
-			else if (firstEmpty == componentClassesCount<CAPACITY> &&
-				std::holds_alternative<std::monostate>(pooledEntity_->components_[i]))
-			{
-				firstEmpty = i;
-			}
+			return false;
 		}
 
-		// if we've reached here than firstEmpty != componentClassesCount<CAPACITY>.
-		// proof by negation: assume firstEmpty == componentClassesCount<CAPACITY> then
-		// none of pooledEntity_->components_ is std::monostate, hence some variant 
-		// is already the component the client wished to add, so we've returned false
+		PooledComponent<Component, CAPACITY> compo{ componentPool<Component>().request() };
+		setOwner<Component>(compo, entBody);
+		compoVar = std::move(compo);
 
-		// notice Component is never polymorphic, therefore "typeid(Component)" 
-		// is resolved at compile time, without additional runtime overhead, see "Notes" at -
-		// https://en.cppreference.com/w/cpp/language/typeid
+		return true;
+	}
 
-		if (typeid(Component) == typeid(PhysicsComponent))
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::detach(EntityBody<CAPACITY, Components...>* entBody) noexcept
+	{
+		PooledVariant<CAPACITY, Components...>& compoVar{ entBody->components_[componentSlot<Component, Components...>] };
+		if (std::holds_alternative<std::monostate>(compoVar))
 		{
-			pooledEntity_->components_[firstEmpty] = std::move(entitiesManager_.physicsComponentsPool_.request());
+			return false;
 		}
-		else if (typeid(Component) == typeid(LifetimeComponent))
+
+		compoVar = std::move(std::monostate{});
+		return true;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...> EntitiesManager<CAPACITY, Components...>::view() noexcept
+	{
+		return View<Queried...>{ *this };
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void EntitiesManager<CAPACITY, Components...>::setOwner(const PooledComponent<Component, CAPACITY>& compo, 
+		const EntityBody<CAPACITY, Components...>* entBody) noexcept
+	{
+		componentPool<Component>().setOwner(compo.get(), static_cast<std::uint32_t>(entBody - entitiesPool_.begin()));
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntityHandle EntitiesManager<CAPACITY, Components...>::ownerAt(std::uint32_t bodySlot) noexcept
+	{
+		if (bodySlot == noOwner)
 		{
-			pooledEntity_->components_[firstEmpty] = std::move(entitiesManager_.lifetimeComponentsPool_.request());
+			return EntityHandle{};
 		}
-		else
+		return entitiesPool_.handleOf(entitiesPool_.begin() + bodySlot);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	std::size_t EntitiesManager<CAPACITY, Components...>::countLacking(std::span<Entity> entities) noexcept
+	{
+		return static_cast<std::size_t>(std::ranges::count_if(entities, 
+			[](const Entity& ent) { return !ent.template hasComponent<Component>(); }));
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void EntitiesManager<CAPACITY, Components...>::attachBatch(std::span<Entity> entities, std::vector<PooledComponent<Component, CAPACITY>>& compos) noexcept
+	{
+		std::size_t next{ 0U };
+		for (Entity& ent : entities)
 		{
-			return false;
+			// getComponent yields an empty variant if the component isn't contained
+			PooledVariant<CAPACITY, Components...>& compoVar{ ent.template getComponent<Component>() };
+			if (!std::holds_alternative<PooledComponent<Component, CAPACITY>>(compoVar))
+			{
+				setOwner<Component>(compos[next], ent.pooledEntity_.get());
+				compoVar = std::move(compos[next]);
+				++next;
+			}
 		}
-
-		return true;
 	}
 
-	template <std::size_t CAPACITY>
+	template <std::size_t CAPACITY, ComponentConcept... Components>
 	template <ComponentConcept Component>
-	bool EntitiesManager<CAPACITY>::Entity::removeComponent() noexcept
+	void EntitiesManager<CAPACITY, Components...>::releaseComponents(std::span<Entity> entities) noexcept
 	{
-		bool res{ false };
-		for (PooledVariant<CAPACITY>& component : pooledEntity_->components_)
+		std::vector<PooledComponent<Component, CAPACITY>> compos{};
+		compos.reserve(entities.size());
+		for (Entity& ent : entities)
 		{
-			if (std::holds_alternative<PooledComponent<Component, CAPACITY>>(component))
+			PooledVariant<CAPACITY, Components...>& compoVar{ ent.template getComponent<Component>() };
+			if (std::holds_alternative<PooledComponent<Component, CAPACITY>>(compoVar))
 			{
-				component = std::move(std::monostate{});
-				res = true;
-				break;
+				compos.push_back(std::move(std::get<PooledComponent<Component, CAPACITY>>(compoVar)));
+				compoVar = std::move(std::monostate{});
 			}
 		}
-		return res;
+
+		componentPool<Component>().releaseBatch(compos);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void EntitiesManager<CAPACITY, Components...>::save(std::ostream& out) const noexcept(false)
+	{
+		snapshot::write(out, snapshot::magic);
+		snapshot::write(out, snapshot::version);
+		snapshot::write(out, snapshot::byteOrderMark);
+		snapshot::write(out, static_cast<std::uint64_t>(CAPACITY));
+		snapshot::write(out, static_cast<std::uint32_t>(sizeof...(Components)));
+		(snapshot::write(out, layoutOf<Components>()), ...);
+		snapshot::write(out, groupsCount);
+		snapshot::write(out, static_cast<std::uint64_t>(nextId_s.load(std::memory_order_relaxed)));
+
+		entitiesPool_.save(out);
+		(saveComponents<Components>(out), ...);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::vector<typename EntitiesManager<CAPACITY, Components...>::Entity> EntitiesManager<CAPACITY, Components...>::load(std::istream& in) noexcept(false)
+	{
+		snapshot::expect(in, snapshot::magic, "snapshot: not a snapshot.");
+		snapshot::expect(in, snapshot::version, "snapshot: saved in another format version.");
+		snapshot::expect(in, snapshot::byteOrderMark, "snapshot: saved on a machine of another byte order.");
+		snapshot::expect(in, static_cast<std::uint64_t>(CAPACITY), "snapshot: saved by a manager of another capacity.");
+		snapshot::expect(in, static_cast<std::uint32_t>(sizeof...(Components)), "snapshot: saved by a manager of other components.");
+		(snapshot::expect(in, layoutOf<Components>(), "snapshot: saved by a manager of other components."), ...);
+		snapshot::expect(in, groupsCount, "snapshot: saved with other groups.");
+
+		// the counter is shared by every manager of this type, so it only moves forward and ids stay unique
+		const EntityId savedNextId{ static_cast<EntityId>(snapshot::read<std::uint64_t>(in)) };
+		EntityId nextId{ nextId_s.load(std::memory_order_relaxed) };
+		while (nextId < savedNextId && !nextId_s.compare_exchange_weak(nextId, savedNextId, std::memory_order_relaxed))
+		{ }
+
+		// if loading a component pool throws, the bodies release the components attached so far on their way out
+		std::vector<PooledEntityBody<CAPACITY, Components...>> entBodies{ entitiesPool_.load(in) };
+		(loadComponents<Components>(in), ...);
+
+		std::vector<Entity> entities{};
+		entities.reserve(entBodies.size());
+		for (PooledEntityBody<CAPACITY, Components...>& entBody : entBodies)
+		{
+			entities.push_back(Entity{ *this, std::move(entBody) });
+		}
+
+		return entities;
 	}
 
-	template <std::size_t CAPACITY>
-	bool EntitiesManager<CAPACITY>::Entity::isMemberOf(Group group) const noexcept
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	constexpr std::array<std::uint64_t, 3U> EntitiesManager<CAPACITY, Components...>::layoutOf() noexcept
 	{
-		const auto grpsEnd{ std::cend(pooledEntity_->groups_) };
-		return std::find(std::cbegin(pooledEntity_->groups_), grpsEnd, group) != grpsEnd;
+		return { sizeof(Component), alignof(Component), SoaComponent<Component> ? 1U : 0U };
 	}
 
-	template <std::size_t CAPACITY>
-	bool EntitiesManager<CAPACITY>::Entity::enrollToGroup(Group group) noexcept
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void EntitiesManager<CAPACITY, Components...>::saveComponents(std::ostream& out) const noexcept(false)
 	{
-		std::size_t firstEmpty{ groupsCount };
-		for (std::size_t i{ 0U }; i != groupsCount; ++i)
+		const ComponentPool<Component, CAPACITY>& pool{ std::get<ComponentPool<Component, CAPACITY>>(componentPools_) };
+		pool.save(out);
+
+		const std::array<std::uint32_t, CAPACITY>& owners{ pool.owners() };
+		std::vector<std::uint32_t> attachedTo{};
+		attachedTo.reserve(pool.size());
+		for (const std::size_t slot : pool.occupancy())
 		{
-			if (pooledEntity_->groups_[i] == group)
+			attachedTo.push_back(owners[slot]);
+		}
+		snapshot::write(out, std::span<const std::uint32_t>{ attachedTo });
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	void EntitiesManager<CAPACITY, Components...>::loadComponents(std::istream& in) noexcept(false)
+	{
+		std::vector<PooledComponent<Component, CAPACITY>> compos{ componentPool<Component>().load(in) };
+
+		std::vector<std::uint32_t> attachedTo(compos.size());
+		snapshot::read(in, std::span<std::uint32_t>{ attachedTo });
+
+		for (std::size_t i{ 0U }; i != compos.size(); ++i)
+		{
+			const std::uint32_t bodySlot{ attachedTo[i] };
+			if (bodySlot >= CAPACITY || !entitiesPool_.occupancy().test(bodySlot))
 			{
-				return false;
+				throw snapshot_exception{ "snapshot: a component is attached to an entity which isn't live." };
 			}
-			else if (firstEmpty == groupsCount &&
-				pooledEntity_->groups_[i] == Group::emptyVal)
+
+			EntityBody<CAPACITY, Components...>* entBody{ entitiesPool_.begin() + bodySlot };
+			PooledVariant<CAPACITY, Components...>& compoVar{ entBody->components_[componentSlot<Component, Components...>] };
+			if (!std::holds_alternative<std::monostate>(compoVar))
 			{
-				firstEmpty = i;
+				throw snapshot_exception{ "snapshot: an entity holds two components of the same type." };
 			}
+
+			setOwner<Component>(compos[i], entBody);
+			compoVar = std::move(compos[i]);
 		}
+	}
 
-		pooledEntity_->groups_[firstEmpty] = group;
-		return true;
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	bool EntitiesManager<CAPACITY, Components...>::isFull() const noexcept
+	{
+		return entitiesPool_.isFull();
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	std::size_t EntitiesManager<CAPACITY, Components...>::size() const noexcept
+	{
+		return entitiesPool_.size();
+	}
+
+	//////// Entity definitions //////// 
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntityId EntitiesManager<CAPACITY, Components...>::Entity::getId() const noexcept
+	{
+		return pooledEntity_->id_;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntityHandle EntitiesManager<CAPACITY, Components...>::Entity::getHandle() const noexcept
+	{
+		return entitiesManager_.entitiesPool_.handleOf(pooledEntity_.get());
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntitiesManager<CAPACITY, Components...>::Entity::Entity(EntitiesManager& entitiesManager)
+		: entitiesManager_{ entitiesManager }
+		, pooledEntity_{ entitiesManager_.entitiesPool_.request() }
+	{ }
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	EntitiesManager<CAPACITY, Components...>::Entity::Entity(EntitiesManager& entitiesManager, PooledEntityBody<CAPACITY, Components...>&& pooledEntity) noexcept
+		: entitiesManager_{ entitiesManager }
+		, pooledEntity_{ std::move(pooledEntity) }
+	{ }
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::hasComponent() const noexcept
+	{
+		return std::holds_alternative<PooledComponent<Component, CAPACITY>>(pooledEntity_->components_[componentSlot<Component, Components...>]);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	PooledVariant<CAPACITY, Components...>& EntitiesManager<CAPACITY, Components...>::Entity::getComponent() noexcept
+	{
+		// notice that due to EntityBody's definition if the wanted component isn't contained,
+		// then its slot holds a std::monostate
+		return pooledEntity_->components_[componentSlot<Component, Components...>];
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::addComponent() noexcept(false)
+	{
+		return entitiesManager_.template attach<Component>(pooledEntity_.get());
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept Component>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::removeComponent() noexcept
+	{
+		return detach<Component>(pooledEntity_.get());
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::isMemberOf(Group group) const noexcept
+	{
+		return (pooledEntity_->groups_ & group_bit(group)) != 0U;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::enrollToGroup(Group group) noexcept
+	{
+		return entitiesManager_.entitiesPool_.enroll(pooledEntity_.get(), group);
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	bool EntitiesManager<CAPACITY, Components...>::Entity::dismissFromGroup(Group group) noexcept
+	{
+		return entitiesManager_.entitiesPool_.dismiss(pooledEntity_.get(), group);
 	}
 
-	template <std::size_t CAPACITY>
-	bool EntitiesManager<CAPACITY>::Entity::dismissFromGroup(Group group) noexcept
+	//////// View definitions //////// 
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...>::View(EntitiesManager& entitiesManager) noexcept
+		: entitiesManager_{ &entitiesManager }
+		, groups_{ 0U }
+	{ }
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...> EntitiesManager<CAPACITY, Components...>::View<Queried...>::with(Group group) const noexcept
+	{
+		View filtered{ *this };
+		filtered.groups_ |= group_bit(group);
+		return filtered;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator EntitiesManager<CAPACITY, Components...>::View<Queried...>::begin() const noexcept
 	{
-		const auto it{ std::ranges::find(pooledEntity_->groups_, group) };
-		if (it != std::end(pooledEntity_->groups_))
+		// drive the iteration from the pool with the fewest live components
+		std::size_t driverSlot{ componentSlot<std::tuple_element_t<0U, std::tuple<Queried...>>, Components...> };
+		std::size_t driverSize{ CAPACITY + 1U };
+		([&]()
+			{
+				const std::size_t size{ entitiesManager_->template componentPool<Queried>().size() };
+				if (size < driverSize)
+				{
+					driverSize = size;
+					driverSlot = componentSlot<Queried, Components...>;
+				}
+			}(), ...);
+
+		// when most entities hold it anyway, walking the entities themselves in slot order 
+		// is cheaper than jumping to each component's owner
+		if (driverSize * 2U >= entitiesManager_->entitiesPool_.size())
 		{
-			*it = Group::emptyVal;
-			return true;
+			return Iterator{ entitiesManager_->entitiesPool_.begin(), groups_, entitiesManager_->entitiesPool_.occupancy(), nullptr };
 		}
-		else
+
+		const OccupancyBitset<CAPACITY>* driver{ nullptr };
+		const std::array<std::uint32_t, CAPACITY>* owners{ nullptr };
+		([&]()
+			{
+				if (componentSlot<Queried, Components...> == driverSlot)
+				{
+					driver = &entitiesManager_->template componentPool<Queried>().occupancy();
+					owners = &entitiesManager_->template componentPool<Queried>().owners();
+				}
+			}(), ...);
+
+		return Iterator{ entitiesManager_->entitiesPool_.begin(), groups_, *driver, owners };
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	std::default_sentinel_t EntitiesManager<CAPACITY, Components...>::View<Queried...>::end() const noexcept
+	{
+		return std::default_sentinel;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	bool EntitiesManager<CAPACITY, Components...>::View<Queried...>::matches(const EntityBody<CAPACITY, Components...>& entBody, GroupMask groups) noexcept
+	{
+		if (!(std::holds_alternative<PooledComponent<Queried, CAPACITY>>(entBody.components_[componentSlot<Queried, Components...>]) && ...))
 		{
 			return false;
 		}
+
+		return (entBody.groups_ & groups) == groups;
+	}
+
+	//////// View::Iterator definitions //////// 
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::Iterator(EntityBody<CAPACITY, Components...>* entBodies, GroupMask groups,
+		const OccupancyBitset<CAPACITY>& driver, const std::array<std::uint32_t, CAPACITY>* owners) noexcept
+		: entBodies_{ entBodies }
+		, groups_{ groups }
+		, owners_{ owners }
+		, slots_{ driver.begin() }
+		, entBody_{ nullptr }
+	{
+		settle();
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...>::value_type EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::operator*() const noexcept
+	{
+		return value_type{ 
+			*std::get<PooledComponent<Queried, CAPACITY>>(entBody_->components_[componentSlot<Queried, Components...>]).get()... };
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator& EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::operator++() noexcept
+	{
+		++slots_;
+		settle();
+		return *this;
 	}
 
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	void EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::operator++(int) noexcept
+	{
+		++*this;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	bool EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::operator==(std::default_sentinel_t) const noexcept
+	{
+		return slots_ == std::default_sentinel;
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	template <ComponentConcept... Queried>
+	void EntitiesManager<CAPACITY, Components...>::View<Queried...>::Iterator::settle() noexcept
+	{
+		for (; slots_ != std::default_sentinel; ++slots_)
+		{
+			const std::uint32_t bodySlot{ owners_ != nullptr ? (*owners_)[*slots_] : static_cast<std::uint32_t>(*slots_) };
+			if (bodySlot == noOwner)
+			{
+				// a component requested from its pool directly, which no entity holds
+				continue;
+			}
+
+			entBody_ = entBodies_ + bodySlot;
+			if (matches(*entBody_, groups_))
+			{
+				return;
+			}
+		}
+	}
 }
 #endif // !ENTITIES_MANAGER
\ No newline at end of file
@@ -0,0 +1,478 @@
+#ifndef ARCHETYPE_STORAGE
+#define ARCHETYPE_STORAGE
+
+#include "EntitiesPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <vector>
+
+
+namespace ecs
+{
+    // An alternative to EntitiesManager, for entities which are mostly iterated by several components at once.
+    // Entities with the same set of components (their archetype) are stored together,
+    // in chunks of chunkBytes_s bytes holding a column per component, so a query over
+    // Physics + Lifetime is a linear scan over the matching archetypes' chunks.
+    // Rows are kept dense: destroying an entity moves the archetype's last row into the hole,
+    // and adding or removing a component moves the entity's row to another archetype,
+    // both with memcpy since components are trivially copyable.
+    // A row holding every component, each column padded to a cache line, must fit in a single chunk.
+    //
+    // Ids are this storage's slots in [0, CAPACITY), reused after destroy.
+    // Every call taking an id checks it's alive, a destroyed or out of range id is ignored;
+    // ids carry no generation though, so an id kept past its destroy names whichever entity reuses the slot.
+    // NOTE: not thread-safe, and component pointers are invalidated by any create, destroy, add or remove
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    class ArchetypeStorage
+    {
+        static_assert(sizeof...(Components) <= 64U, "an archetype's signature is a 64 bit mask");
+        static_assert(((count_of<Components, Components...> == 1U) && ...), "every component type may be registered only once");
+
+    public:
+        static constexpr std::size_t chunkBytes_s{ 16U * 1024U };
+
+        ArchetypeStorage() noexcept(false);
+
+        // a new entity holding value initialized Initial components
+        template <ComponentConcept... Initial>
+        [[nodiscard]] EntityId create() noexcept(false);
+
+        // no-op unless id is alive
+        void destroy(EntityId id) noexcept;
+
+        [[nodiscard]] bool isAlive(EntityId id) const noexcept;
+
+        // false unless id is alive
+        template <ComponentConcept Component>
+        [[nodiscard]] bool has(EntityId id) const noexcept;
+
+        // nullptr if the entity doesn't hold Component or id isn't alive
+        template <ComponentConcept Component>
+        [[nodiscard]] Component* get(EntityId id) noexcept;
+
+        // moves the entity to the archetype with Component as well, returns false if it already holds one or id isn't alive
+        template <ComponentConcept Component>
+        bool add(EntityId id) noexcept(false);
+
+        // moves the entity to the archetype without Component, returns false if it doesn't hold one or id isn't alive
+        template <ComponentConcept Component>
+        bool remove(EntityId id) noexcept(false);
+
+        // func(Queried&...) for every entity holding all of Queried
+        template <ComponentConcept... Queried, typename Func>
+        void forEach(Func&& func);
+
+        // func(std::span<const EntityId>, std::span<Queried>...) for every non empty chunk of
+        // every archetype holding all of Queried, the spans are the chunk's columns
+        template <ComponentConcept... Queried, typename Func>
+        void forEachChunk(Func&& func);
+
+        [[nodiscard]] consteval std::size_t capacity() const noexcept;
+
+        [[nodiscard]] std::size_t size() const noexcept;
+
+        [[nodiscard]] bool isFull() const noexcept;
+
+        [[nodiscard]] std::size_t archetypesCount() const noexcept;
+
+    private:
+        static constexpr std::size_t componentsCount_s{ sizeof...(Components) };
+        static constexpr std::uint32_t none_s{ 0xFFFF'FFFFU };
+        static constexpr std::size_t columnAlignment_s{ 64U };
+
+        static constexpr std::array<std::size_t, componentsCount_s> sizes_s{ sizeof(Components)... };
+
+        [[nodiscard]] static constexpr std::size_t alignColumn(std::size_t bytes) noexcept
+        {
+            return (bytes + columnAlignment_s - 1U) / columnAlignment_s * columnAlignment_s;
+        }
+
+        // a chunk must hold at least one row of every archetype, padding included, or rowsPerChunk_ would be 0
+        static_assert(alignColumn(sizeof(EntityId)) + (alignColumn(sizeof(Components)) + ... + 0U) <= chunkBytes_s,
+            "a row of all the components, each column cache line aligned, must fit in a chunk");
+
+        using Constructor = void (*)(std::byte*);
+        static constexpr std::array<Constructor, componentsCount_s> constructors_s{
+            [](std::byte* place) { ::new (static_cast<void*>(place)) Components{}; }... };
+
+        struct alignas(64) Chunk
+        {
+            std::array<std::byte, chunkBytes_s> bytes_;
+        };
+
+        struct Archetype
+        {
+            std::uint64_t signature_;
+            std::size_t rowsPerChunk_;
+            // byte offset of every component's column in a chunk, the ids' column is at 0
+            std::array<std::size_t, componentsCount_s> offsets_;
+            std::vector<std::unique_ptr<Chunk>> chunks_;
+            std::size_t size_;
+            // the archetypes reached by adding or removing each component, resolved on first use
+            std::array<std::uint32_t, componentsCount_s> addEdges_;
+            std::array<std::uint32_t, componentsCount_s> removeEdges_;
+        };
+
+        struct Location
+        {
+            std::uint32_t archetype_;
+            std::uint32_t row_;
+        };
+
+        std::vector<Archetype> archetypes_;
+        std::array<Location, CAPACITY> locations_;
+        std::array<EntityId, CAPACITY> freeIds_;
+        std::size_t freeCount_;
+
+        template <ComponentConcept Component>
+        [[nodiscard]] static constexpr std::uint64_t bit() noexcept;
+
+        [[nodiscard]] std::uint32_t archetypeOf(std::uint64_t signature) noexcept(false);
+
+        [[nodiscard]] std::uint32_t neighbour(std::uint32_t from, std::size_t componentIdx, bool adding) noexcept(false);
+
+        [[nodiscard]] static std::byte* cell(Archetype& archetype, std::size_t columnOffset, std::size_t cellSize, std::size_t row) noexcept;
+
+        // appends a row for id, its components are left uninitialized
+        [[nodiscard]] std::uint32_t pushRow(Archetype& archetype, EntityId id) noexcept(false);
+
+        // moves the last row into row
+        void eraseRow(Archetype& archetype, std::uint32_t row) noexcept;
+
+        void move(EntityId id, std::uint32_t to) noexcept(false);
+    };
+
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    ArchetypeStorage<CAPACITY, Components...>::ArchetypeStorage() noexcept(false)
+        : archetypes_{}
+        , locations_{}
+        , freeIds_{}
+        , freeCount_{ CAPACITY }
+    {
+        // ids are handed out from the back, lowest first
+        for (std::size_t i{ 0U }; i != CAPACITY; ++i)
+        {
+            freeIds_[i] = CAPACITY - 1U - i;
+            locations_[i] = Location{ none_s, 0U };
+        }
+
+        // the empty archetype, for entities without components
+        static_cast<void>(archetypeOf(0U));
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept... Initial>
+    EntityId ArchetypeStorage<CAPACITY, Components...>::create() noexcept(false)
+    {
+        if (freeCount_ == 0U)
+        {
+            throw entities_max_capacity_exception{};
+        }
+
+        const std::uint32_t archetypeIdx{ archetypeOf((std::uint64_t{ 0U } | ... | bit<Initial>())) };
+        Archetype& archetype{ archetypes_[archetypeIdx] };
+
+        const EntityId id{ freeIds_[freeCount_ - 1U] };
+        const std::uint32_t row{ pushRow(archetype, id) };
+        --freeCount_;
+
+        for (std::size_t c{ 0U }; c != componentsCount_s; ++c)
+        {
+            if ((archetype.signature_ >> c) & 1U)
+            {
+                constructors_s[c](cell(archetype, archetype.offsets_[c], sizes_s[c], row));
+            }
+        }
+
+        locations_[id] = Location{ archetypeIdx, row };
+        return id;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void ArchetypeStorage<CAPACITY, Components...>::destroy(EntityId id) noexcept
+    {
+        if (!isAlive(id))
+        {
+            return;
+        }
+
+        Location& location{ locations_[id] };
+        eraseRow(archetypes_[location.archetype_], location.row_);
+        location = Location{ none_s, 0U };
+        freeIds_[freeCount_++] = id;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool ArchetypeStorage<CAPACITY, Components...>::isAlive(EntityId id) const noexcept
+    {
+        return id < CAPACITY && locations_[id].archetype_ != none_s;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept Component>
+    bool ArchetypeStorage<CAPACITY, Components...>::has(EntityId id) const noexcept
+    {
+        return isAlive(id) && (archetypes_[locations_[id].archetype_].signature_ & bit<Component>()) != 0U;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept Component>
+    Component* ArchetypeStorage<CAPACITY, Components...>::get(EntityId id) noexcept
+    {
+        if (!isAlive(id))
+        {
+            return nullptr;
+        }
+
+        const Location location{ locations_[id] };
+        Archetype& archetype{ archetypes_[location.archetype_] };
+        if ((archetype.signature_ & bit<Component>()) == 0U)
+        {
+            return nullptr;
+        }
+
+        constexpr std::size_t slot{ componentSlot<Component, Components...> };
+        return std::launder(reinterpret_cast<Component*>(cell(archetype, archetype.offsets_[slot], sizeof(Component), location.row_)));
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept Component>
+    bool ArchetypeStorage<CAPACITY, Components...>::add(EntityId id) noexcept(false)
+    {
+        if (!isAlive(id) || has<Component>(id))
+        {
+            return false;
+        }
+
+        move(id, neighbour(locations_[id].archetype_, componentSlot<Component, Components...>, true));
+        return true;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept Component>
+    bool ArchetypeStorage<CAPACITY, Components...>::remove(EntityId id) noexcept(false)
+    {
+        if (!has<Component>(id))
+        {
+            return false;
+        }
+
+        move(id, neighbour(locations_[id].archetype_, componentSlot<Component, Components...>, false));
+        return true;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept... Queried, typename Func>
+    void ArchetypeStorage<CAPACITY, Components...>::forEach(Func&& func)
+    {
+        forEachChunk<Queried...>([&func](std::span<const EntityId> ids, std::span<Queried>... columns)
+            {
+                for (std::size_t row{ 0U }; row != ids.size(); ++row)
+                {
+                    func(columns[row]...);
+                }
+            });
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept... Queried, typename Func>
+    void ArchetypeStorage<CAPACITY, Components...>::forEachChunk(Func&& func)
+    {
+        constexpr std::uint64_t mask{ (std::uint64_t{ 0U } | ... | bit<Queried>()) };
+
+        for (Archetype& archetype : archetypes_)
+        {
+            if ((archetype.signature_ & mask) != mask)
+            {
+                continue;
+            }
+
+            for (std::size_t chunkIdx{ 0U }; chunkIdx * archetype.rowsPerChunk_ < archetype.size_; ++chunkIdx)
+            {
+                std::byte* const bytes{ archetype.chunks_[chunkIdx]->bytes_.data() };
+                const std::size_t rows{ std::min(archetype.rowsPerChunk_, archetype.size_ - chunkIdx * archetype.rowsPerChunk_) };
+
+                func(std::span<const EntityId>{ std::launder(reinterpret_cast<const EntityId*>(bytes)), rows },
+                    std::span<Queried>{ std::launder(reinterpret_cast<Queried*>(bytes + archetype.offsets_[componentSlot<Queried, Components...>])), rows }...);
+            }
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    consteval std::size_t ArchetypeStorage<CAPACITY, Components...>::capacity() const noexcept
+    {
+        return CAPACITY;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::size_t ArchetypeStorage<CAPACITY, Components...>::size() const noexcept
+    {
+        return CAPACITY - freeCount_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool ArchetypeStorage<CAPACITY, Components...>::isFull() const noexcept
+    {
+        return freeCount_ == 0U;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::size_t ArchetypeStorage<CAPACITY, Components...>::archetypesCount() const noexcept
+    {
+        return archetypes_.size();
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    template <ComponentConcept Component>
+    constexpr std::uint64_t ArchetypeStorage<CAPACITY, Components...>::bit() noexcept
+    {
+        return std::uint64_t{ 1U } << componentSlot<Component, Components...>;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::uint32_t ArchetypeStorage<CAPACITY, Components...>::archetypeOf(std::uint64_t signature) noexcept(false)
+    {
+        // archetypes are few and created once, a linear search only runs when an edge is first resolved
+        for (std::uint32_t i{ 0U }; i != archetypes_.size(); ++i)
+        {
+            if (archetypes_[i].signature_ == signature)
+            {
+                return i;
+            }
+        }
+
+        // columns are cache line aligned, so as many rows as fit including the alignment padding
+        std::size_t rowBytes{ sizeof(EntityId) };
+        for (std::size_t c{ 0U }; c != componentsCount_s; ++c)
+        {
+            rowBytes += ((signature >> c) & 1U) * sizes_s[c];
+        }
+
+        Archetype archetype{ signature, chunkBytes_s / rowBytes, {}, {}, 0U, {}, {} };
+        archetype.addEdges_.fill(none_s);
+        archetype.removeEdges_.fill(none_s);
+        for (;;)
+        {
+            std::size_t offset{ alignColumn(sizeof(EntityId) * archetype.rowsPerChunk_) };
+            for (std::size_t c{ 0U }; c != componentsCount_s; ++c)
+            {
+                archetype.offsets_[c] = offset;
+                if ((signature >> c) & 1U)
+                {
+                    offset = alignColumn(offset + sizes_s[c] * archetype.rowsPerChunk_);
+                }
+            }
+
+            if (offset <= chunkBytes_s)
+            {
+                break;
+            }
+            --archetype.rowsPerChunk_;
+        }
+
+        archetypes_.push_back(std::move(archetype));
+        return static_cast<std::uint32_t>(archetypes_.size() - 1U);
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::uint32_t ArchetypeStorage<CAPACITY, Components...>::neighbour(std::uint32_t from, std::size_t componentIdx, bool adding) noexcept(false)
+    {
+        std::uint32_t& edge{ adding ? archetypes_[from].addEdges_[componentIdx] : archetypes_[from].removeEdges_[componentIdx] };
+        if (edge == none_s)
+        {
+            const std::uint64_t signature{ archetypes_[from].signature_ ^ (std::uint64_t{ 1U } << componentIdx) };
+
+            // archetypeOf may reallocate archetypes_, so the edge is written afterwards
+            const std::uint32_t to{ archetypeOf(signature) };
+            (adding ? archetypes_[from].addEdges_[componentIdx] : archetypes_[from].removeEdges_[componentIdx]) = to;
+            return to;
+        }
+        return edge;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::byte* ArchetypeStorage<CAPACITY, Components...>::cell(Archetype& archetype, std::size_t columnOffset, std::size_t cellSize, std::size_t row) noexcept
+    {
+        const std::size_t chunkIdx{ row / archetype.rowsPerChunk_ };
+        const std::size_t chunkRow{ row % archetype.rowsPerChunk_ };
+        return archetype.chunks_[chunkIdx]->bytes_.data() + columnOffset + chunkRow * cellSize;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::uint32_t ArchetypeStorage<CAPACITY, Components...>::pushRow(Archetype& archetype, EntityId id) noexcept(false)
+    {
+        // chunks are kept once allocated, an archetype which shrank and grows again reuses them
+        if (archetype.size_ == archetype.chunks_.size() * archetype.rowsPerChunk_)
+        {
+            archetype.chunks_.push_back(std::make_unique<Chunk>());
+        }
+
+        const std::uint32_t row{ static_cast<std::uint32_t>(archetype.size_++) };
+        std::memcpy(cell(archetype, 0U, sizeof(EntityId), row), &id, sizeof(EntityId));
+        return row;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void ArchetypeStorage<CAPACITY, Components...>::eraseRow(Archetype& archetype, std::uint32_t row) noexcept
+    {
+        const std::uint32_t last{ static_cast<std::uint32_t>(archetype.size_ - 1U) };
+        if (row != last)
+        {
+            EntityId movedId{};
+            std::memcpy(&movedId, cell(archetype, 0U, sizeof(EntityId), last), sizeof(EntityId));
+            std::memcpy(cell(archetype, 0U, sizeof(EntityId), row), &movedId, sizeof(EntityId));
+
+            for (std::size_t c{ 0U }; c != componentsCount_s; ++c)
+            {
+                if ((archetype.signature_ >> c) & 1U)
+                {
+                    std::memcpy(cell(archetype, archetype.offsets_[c], sizes_s[c], row),
+                        cell(archetype, archetype.offsets_[c], sizes_s[c], last), sizes_s[c]);
+                }
+            }
+
+            locations_[movedId].row_ = row;
+        }
+        --archetype.size_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void ArchetypeStorage<CAPACITY, Components...>::move(EntityId id, std::uint32_t to) noexcept(false)
+    {
+        const Location from{ locations_[id] };
+        Archetype& source{ archetypes_[from.archetype_] };
+        Archetype& target{ archetypes_[to] };
+
+        const std::uint32_t row{ pushRow(target, id) };
+        for (std::size_t c{ 0U }; c != componentsCount_s; ++c)
+        {
+            if (((target.signature_ >> c) & 1U) == 0U)
+            {
+                continue;
+            }
+
+            std::byte* const dest{ cell(target, target.offsets_[c], sizes_s[c], row) };
+            if ((source.signature_ >> c) & 1U)
+            {
+                std::memcpy(dest, cell(source, source.offsets_[c], sizes_s[c], from.row_), sizes_s[c]);
+            }
+            else
+            {
+                constructors_s[c](dest);
+            }
+        }
+
+        eraseRow(source, from.row_);
+        locations_[id] = Location{ to, row };
+    }
+}
+
+#endif // !ARCHETYPE_STORAGE
@@ -2,12 +2,17 @@
 #ifndef COMPONENT_OBJECT_POOL
 #define COMPONENT_OBJECT_POOL
 
-#include "PhysicsComponent.hpp"
-#include "LifetimeComponent.hpp"
+#include "OccupancyBitset.hpp"
+#include "ComponentStorage.hpp"
+#include "Snapshot.hpp"
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <mutex>
+#include <ranges>
+#include <span>
+#include <vector>
 #include <iostream>
 
 namespace ecs
@@ -15,17 +20,14 @@ namespace ecs
     template <typename T, typename... Us>
     concept same_as_any_of = (std::same_as<T, Us> || ...);
 
-    template<typename Component>
-    concept has_valid_bool = requires(Component compo)
-    {
-        requires std::same_as<decltype(compo.valid), bool>;
-    };
-
+    // any trivially copyable type may be a component, 
+    // it's registered by naming it in EntitiesManager's Components.
+    // The pools don't include any component's header, code naming a component includes its header itself,
+    // e.g. "PhysicsComponent.hpp" for ecs::PhysicsComponent
     template<typename Component>
     concept ComponentConcept = 
         std::is_trivially_copyable_v<Component> && 
-        has_valid_bool<Component> &&
-        same_as_any_of<Component, PhysicsComponent, LifetimeComponent>;
+        std::is_default_constructible_v<Component>;
 
 
     template <ComponentConcept Component, std::size_t CAPACITY>
@@ -35,11 +37,14 @@ namespace ecs
     class ComponentDeleter
     {
     public:
+        // Component* for array-of-structs pools, SoaPointer for structure-of-arrays pools
+        using pointer = typename ComponentStorage<Component, CAPACITY>::pointer;
+
         ComponentDeleter(ComponentPool<Component, CAPACITY>& compoPool)
             : compoPool_{ &compoPool }
         { }
 
-        void operator()(Component* compo) const
+        void operator()(pointer compo) const
         {
             // NOTE: The pool's lifetime must exceed that of its objects, 
             // otherwise it'll lead to undefined behavior
@@ -56,6 +61,10 @@ namespace ecs
     using PooledComponent = std::unique_ptr<Component, ComponentDeleter<Component, CAPACITY>>;
 
 
+    // what a component pool's owner table holds for a slot which isn't attached to anything
+    inline constexpr std::uint32_t noOwner{ 0xFFFF'FFFFU };
+
+
     class components_max_capacity_exception : public std::bad_alloc
     {
     public:
@@ -66,88 +75,332 @@ namespace ecs
     };
 
 
+    // The free slots form a Treiber stack threaded through nextFree_.
+    // stackTop_ packs the index of the top free slot (low 32 bits) together with
+    // a tag (high 32 bits) which is bumped on every push and pop, so a stale
+    // compare-exchange can't succeed after the same slot was popped and pushed back (ABA).
+    // An index of CAPACITY marks an empty stack.
+    // Slots are only pushed once released: slots which were never handed out lie past highWater_,
+    // and are handed out in order once the stack runs dry. So construction writes nothing per slot,
+    // and the pages of slots which are never used are never touched.
+    // 
+    // Which slots are live is tracked by occupancy_ rather than by the components themselves,
+    // so systems can iterate only over live components via live().
+    // There's deliberately no packed index of the live slots: keeping one dense under swap-remove would either
+    // put a lock back on request() and release(), or move components out from under their PooledComponents.
+    // The bitset skips 64 free slots per word instead, so a sparse pool is still iterated at nearly dense speed.
+    //
+    // Components are stored as an array of structs, unless they specialize soa_layout,
+    // in which case the pool keeps one array per field, exposed through column().
     template <ComponentConcept Component, std::size_t CAPACITY>
     class ComponentPool
     {
+        static_assert(CAPACITY < 0xFFFF'FFFFU, "slot indices must fit in the 32 index bits of stackTop_");
+
     public:
+        // Component* for array-of-structs pools, SoaPointer for structure-of-arrays pools
+        using pointer = typename ComponentStorage<Component, CAPACITY>::pointer;
+        // what dereferencing a pointer yields, Component& or SoaReference
+        using reference = typename ComponentStorage<Component, CAPACITY>::reference;
+
         ComponentPool() noexcept;
 
         [[nodiscard]] PooledComponent<Component, CAPACITY> request() noexcept(false);
 
+        // pops count slots off the free list with a single compare-exchange,
+        // either all of them are handed out or none (and it throws)
+        [[nodiscard]] std::vector<PooledComponent<Component, CAPACITY>> requestBatch(std::size_t count) noexcept(false);
+
+        // pushes all the components back onto the free list with a single compare-exchange,
+        // leaving the given PooledComponents empty
+        void releaseBatch(std::span<PooledComponent<Component, CAPACITY>> compos) noexcept;
+
         [[nodiscard]] consteval std::size_t capacity() const noexcept;
 
         [[nodiscard]] std::size_t size() const noexcept;
 
         [[nodiscard]] bool isFull() const noexcept;
 
-        Component* begin() noexcept;
+        // all slots, live or not, see occupancy(). Slots never handed out hold indeterminate values
+        Component* begin() noexcept requires (!SoaComponent<Component>);
+
+        Component* end() noexcept requires (!SoaComponent<Component>);
+
+        // the whole column of a structure-of-arrays component's field, live slots or not, see occupancy().
+        // Slots never handed out hold indeterminate values
+        template <auto Member>
+        [[nodiscard]] auto column() noexcept requires SoaComponent<Component>;
+
+        [[nodiscard]] const OccupancyBitset<CAPACITY>& occupancy() const noexcept;
+
+        // the slot of a component handed out by this pool
+        [[nodiscard]] std::size_t slotOf(pointer compo) const noexcept;
 
-        Component* end() noexcept;
+        // records what a live component is attached to (EntitiesManager stores its entity body slot),
+        // the entry goes back to noOwner whenever the slot is handed out or released
+        void setOwner(pointer compo, std::uint32_t owner) noexcept;
+
+        // the owner table by slot, noOwner for slots which are live but unattached or free.
+        // Slots never handed out hold indeterminate values
+        [[nodiscard]] const std::array<std::uint32_t, CAPACITY>& owners() const noexcept;
+
+        // a range over the live components only, in slot order.
+        // NOTE: mustn't be iterated while components are requested or released
+        [[nodiscard]] auto live() noexcept requires (!SoaComponent<Component>);
+
+        // same, yielding a SoaReference to each live slot's fields
+        [[nodiscard]] auto live() noexcept requires SoaComponent<Component>;
+
+        // writes the live components, in runs of consecutive slots, and the free stack, see Snapshot.hpp.
+        // NOTE: mustn't be called while components are requested or released
+        void save(std::ostream& out) const noexcept(false);
+
+        // restores what save() wrote into this freshly constructed pool, so it hands out slots in the same order.
+        // Returns the live components in slot order, each one returns to the pool through its PooledComponent as usual.
+        // If it throws the pool should be discarded
+        [[nodiscard]] std::vector<PooledComponent<Component, CAPACITY>> load(std::istream& in) noexcept(false);
 
     private:
         friend class ComponentDeleter<Component, CAPACITY>;
 
-        std::array<Component, CAPACITY> pool_;
-        Component* poolStart_;
-        std::array<std::size_t, CAPACITY> stack_;
-        std::size_t stackTop_;
-        std::size_t size_;
-        std::mutex mutex_;
+        static constexpr std::uint64_t indexMask_s{ 0xFFFF'FFFFU };
+        static constexpr std::uint32_t tagShift_s{ 32U };
+
+        ComponentStorage<Component, CAPACITY> storage_;
+        // accessed through std::atomic_ref, a plain array is left uninitialized until a slot is pushed
+        std::array<std::uint32_t, CAPACITY> nextFree_;
+        // like storage_, an entry is only written once its slot is handed out
+        std::array<std::uint32_t, CAPACITY> owners_;
+        std::atomic<std::uint64_t> stackTop_;
+        std::atomic<std::uint32_t> highWater_;
+        std::atomic<std::size_t> size_;
+        OccupancyBitset<CAPACITY> occupancy_;
         ComponentDeleter<Component, CAPACITY> compoDeleter_;
 
-        void release(Component* compo) noexcept;
+        void release(pointer compo) noexcept;
+
+        // claims count slots past highWater_, returns the first one or CAPACITY if there aren't as many
+        [[nodiscard]] std::uint64_t claimUntouched(std::size_t count) noexcept;
+
+        // pushes a chain of slots, linked first -> ... -> last through nextFree_
+        void pushChain(std::uint64_t first, std::uint64_t last) noexcept;
+
+        [[nodiscard]] std::atomic_ref<std::uint32_t> nextFree(std::uint64_t slot) noexcept;
+
+        [[nodiscard]] static constexpr std::uint64_t makeTop(std::uint64_t idx, std::uint64_t prevTop) noexcept;
     };
 
 
     template <ComponentConcept Component, std::size_t CAPACITY>
     ComponentPool<Component, CAPACITY>::ComponentPool() noexcept
-        : pool_{}
-        , poolStart_{ reinterpret_cast<Component* const>(pool_.data()) }
-        , stack_{}
-        , stackTop_{ 0U }
+        // storage_, nextFree_ and owners_ are left default initialized, see claimUntouched
+        : stackTop_{ CAPACITY }
+        , highWater_{ 0U }
         , size_{ 0U }
-        , mutex_{}
+        , occupancy_{}
         , compoDeleter_{ *this }
+    { }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    PooledComponent<Component, CAPACITY> ComponentPool<Component, CAPACITY>::request() noexcept(false)
     {
-        for (std::size_t i{ 0U }; i != CAPACITY; ++i)
+        std::uint64_t top{ stackTop_.load(std::memory_order_acquire) };
+        std::uint64_t idx{};
+        for (;;)
         {
-            stack_[i] = i;
+            idx = top & indexMask_s;
+            if (idx == CAPACITY)
+            {
+                idx = claimUntouched(1U);
+                if (idx == CAPACITY) [[unlikely]]
+                {
+                    throw components_max_capacity_exception{};
+                }
+                break;
+            }
+
+            // if another thread pops idx first, the value read here may be stale,
+            // but then stackTop_'s tag has changed and the exchange below fails
+            if (stackTop_.compare_exchange_weak(top, makeTop(nextFree(idx).load(std::memory_order_relaxed), top),
+                std::memory_order_acquire, std::memory_order_acquire))
+            {
+                break;
+            }
         }
+
+        size_.fetch_add(1U, std::memory_order_relaxed);
+
+        pointer compo{ storage_.construct(idx) };
+        owners_[idx] = noOwner;
+        occupancy_.set(idx);
+
+        return { compo, compoDeleter_ };
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
-    PooledComponent<Component, CAPACITY> ComponentPool<Component, CAPACITY>::request() noexcept(false)
+    void ComponentPool<Component, CAPACITY>::release(pointer compo) noexcept
     {
-        std::lock_guard lock{ mutex_ };
+        const std::uint64_t freedObjIdx{ storage_.slotOf(compo) };
+
+        owners_[freedObjIdx] = noOwner;
+        occupancy_.reset(freedObjIdx);
+
+        pushChain(freedObjIdx, freedObjIdx);
 
-        if (stackTop_ == CAPACITY) [[unlikely]]
+        size_.fetch_sub(1U, std::memory_order_relaxed);
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    std::vector<PooledComponent<Component, CAPACITY>> ComponentPool<Component, CAPACITY>::requestBatch(std::size_t count) noexcept(false)
+    {
+        std::vector<std::uint64_t> slots(count);
+
+        // slots [count - untouched, count) are claimed past highWater_, the rest is popped off the stack
+        std::size_t untouched{ 0U };
+        std::uint64_t top{ stackTop_.load(std::memory_order_acquire) };
+        for (;;)
         {
-            throw components_max_capacity_exception{};
+            const std::size_t wanted{ count - untouched };
+            std::uint64_t idx{ top & indexMask_s };
+            std::size_t taken{ 0U };
+            for (; taken != wanted && idx != CAPACITY; ++taken)
+            {
+                slots[taken] = idx;
+                idx = nextFree(idx).load(std::memory_order_relaxed);
+            }
+
+            if (taken != wanted)
+            {
+                // the stack falls short, claim the rest past highWater_ and walk again for what's left
+                const std::size_t shortfall{ wanted - taken };
+                const std::uint64_t first{ claimUntouched(shortfall) };
+                if (first != CAPACITY)
+                {
+                    for (std::size_t i{ 0U }; i != shortfall; ++i)
+                    {
+                        slots[taken + i] = first + i;
+                    }
+                    untouched += shortfall;
+                    continue;
+                }
+
+                // the walk might have raced with other threads, 
+                // only if the stack is unchanged there are really not enough free slots
+                const std::uint64_t currTop{ stackTop_.load(std::memory_order_acquire) };
+                if (currTop == top)
+                {
+                    // the slots claimed so far become ordinary free slots
+                    if (untouched != 0U)
+                    {
+                        for (std::size_t i{ count - untouched }; i + 1U != count; ++i)
+                        {
+                            nextFree(slots[i]).store(static_cast<std::uint32_t>(slots[i + 1U]), std::memory_order_relaxed);
+                        }
+                        pushChain(slots[count - untouched], slots[count - 1U]);
+                    }
+                    throw components_max_capacity_exception{};
+                }
+                top = currTop;
+            }
+            else if (taken == 0U || stackTop_.compare_exchange_weak(top, makeTop(idx, top),
+                std::memory_order_acquire, std::memory_order_acquire))
+            {
+                break;
+            }
         }
 
-        ++stackTop_;
+        size_.fetch_add(count, std::memory_order_relaxed);
 
-        ++size_;
+        std::vector<PooledComponent<Component, CAPACITY>> compos{};
+        compos.reserve(count);
+        for (const std::uint64_t slot : slots)
+        {
+            pointer compo{ storage_.construct(slot) };
+            owners_[slot] = noOwner;
+            occupancy_.set(slot);
+            compos.emplace_back(compo, compoDeleter_);
+        }
 
-        Component* compo{ new (&pool_[stack_[stackTop_ - 1U]]) Component{} };
-        compo->valid = true;
+        return compos;
+    }
 
-        return { compo, compoDeleter_ };
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    void ComponentPool<Component, CAPACITY>::releaseBatch(std::span<PooledComponent<Component, CAPACITY>> compos) noexcept
+    {
+        // link the released slots into a chain first, then splice the whole chain on top of the stack
+
+        std::uint64_t first{ CAPACITY };
+        std::uint64_t last{ CAPACITY };
+        std::size_t count{ 0U };
+        for (PooledComponent<Component, CAPACITY>& pooledCompo : compos)
+        {
+            pointer compo{ pooledCompo.release() };
+            if (compo == nullptr)
+            {
+                continue;
+            }
+
+            const std::uint64_t freedObjIdx{ storage_.slotOf(compo) };
+            owners_[freedObjIdx] = noOwner;
+            occupancy_.reset(freedObjIdx);
+            if (last == CAPACITY)
+            {
+                first = freedObjIdx;
+            }
+            else
+            {
+                nextFree(last).store(static_cast<std::uint32_t>(freedObjIdx), std::memory_order_relaxed);
+            }
+            last = freedObjIdx;
+            ++count;
+        }
+
+        if (count == 0U)
+        {
+            return;
+        }
+
+        pushChain(first, last);
+
+        size_.fetch_sub(count, std::memory_order_relaxed);
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
-    void ComponentPool<Component, CAPACITY>::release(Component* compo) noexcept
+    std::uint64_t ComponentPool<Component, CAPACITY>::claimUntouched(std::size_t count) noexcept
     {
-        std::lock_guard lock{ mutex_ };
+        std::uint32_t mark{ highWater_.load(std::memory_order_relaxed) };
+        do
+        {
+            if (CAPACITY - mark < count)
+            {
+                return CAPACITY;
+            }
+        } while (!highWater_.compare_exchange_weak(mark, static_cast<std::uint32_t>(mark + count), std::memory_order_relaxed));
 
-        compo->valid = false;
+        return mark;
+    }
 
-        const std::size_t freedObjIdx{ static_cast<std::size_t>(compo - poolStart_) };
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    void ComponentPool<Component, CAPACITY>::pushChain(std::uint64_t first, std::uint64_t last) noexcept
+    {
+        std::uint64_t top{ stackTop_.load(std::memory_order_relaxed) };
+        do
+        {
+            nextFree(last).store(static_cast<std::uint32_t>(top & indexMask_s), std::memory_order_relaxed);
+        } while (!stackTop_.compare_exchange_weak(top, makeTop(first, top),
+            std::memory_order_release, std::memory_order_relaxed));
+    }
 
-        --stackTop_;
-        stack_[stackTop_] = freedObjIdx;
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    std::atomic_ref<std::uint32_t> ComponentPool<Component, CAPACITY>::nextFree(std::uint64_t slot) noexcept
+    {
+        return std::atomic_ref<std::uint32_t>{ nextFree_[slot] };
+    }
 
-        --size_;
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    constexpr std::uint64_t ComponentPool<Component, CAPACITY>::makeTop(std::uint64_t idx, std::uint64_t prevTop) noexcept
+    {
+        return (((prevTop >> tagShift_s) + 1U) << tagShift_s) | idx;
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
@@ -159,25 +412,145 @@ namespace ecs
     template <ComponentConcept Component, std::size_t CAPACITY>
     std::size_t ComponentPool<Component, CAPACITY>::size() const noexcept
     {
-        return size_;
+        return size_.load(std::memory_order_relaxed);
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
     bool ComponentPool<Component, CAPACITY>::isFull() const noexcept
     {
-        return size_ == CAPACITY;
+        return size() == CAPACITY;
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    Component* ComponentPool<Component, CAPACITY>::begin() noexcept requires (!SoaComponent<Component>)
+    {
+        return storage_.data();
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    Component* ComponentPool<Component, CAPACITY>::end() noexcept requires (!SoaComponent<Component>)
+    {
+        return storage_.data() + CAPACITY;
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    template <auto Member>
+    auto ComponentPool<Component, CAPACITY>::column() noexcept requires SoaComponent<Component>
+    {
+        return storage_.template column<Member>();
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    const OccupancyBitset<CAPACITY>& ComponentPool<Component, CAPACITY>::occupancy() const noexcept
+    {
+        return occupancy_;
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    std::size_t ComponentPool<Component, CAPACITY>::slotOf(pointer compo) const noexcept
+    {
+        return storage_.slotOf(compo);
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    void ComponentPool<Component, CAPACITY>::setOwner(pointer compo, std::uint32_t owner) noexcept
+    {
+        owners_[storage_.slotOf(compo)] = owner;
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    const std::array<std::uint32_t, CAPACITY>& ComponentPool<Component, CAPACITY>::owners() const noexcept
+    {
+        return owners_;
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    auto ComponentPool<Component, CAPACITY>::live() noexcept requires (!SoaComponent<Component>)
+    {
+        return std::ranges::subrange{ occupancy_.begin(), occupancy_.end() } |
+            std::views::transform([this](std::size_t slot) -> Component& { return storage_.at(slot); });
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
-    Component* ComponentPool<Component, CAPACITY>::begin() noexcept
+    auto ComponentPool<Component, CAPACITY>::live() noexcept requires SoaComponent<Component>
     {
-        return poolStart_;
+        return std::ranges::subrange{ occupancy_.begin(), occupancy_.end() } |
+            std::views::transform([this](std::size_t slot) { return *storage_.pointerTo(slot); });
     }
 
     template <ComponentConcept Component, std::size_t CAPACITY>
-    Component* ComponentPool<Component, CAPACITY>::end() noexcept
+    void ComponentPool<Component, CAPACITY>::save(std::ostream& out) const noexcept(false)
     {
-        return poolStart_ + CAPACITY;
+        const std::uint32_t highWater{ highWater_.load(std::memory_order_acquire) };
+        snapshot::write(out, highWater);
+        snapshot::write(out, static_cast<std::uint64_t>(size()));
+        snapshot::write_occupancy(out, occupancy_, highWater);
+
+        // from the top of the stack down, every slot below highWater_ which isn't live is on it
+        std::vector<std::uint32_t> freeSlots{};
+        freeSlots.reserve(highWater - size());
+        for (std::uint64_t idx{ stackTop_.load(std::memory_order_acquire) & indexMask_s }; idx != CAPACITY; idx = nextFree_[idx])
+        {
+            freeSlots.push_back(static_cast<std::uint32_t>(idx));
+        }
+        snapshot::write(out, static_cast<std::uint64_t>(freeSlots.size()));
+        snapshot::write(out, std::span<const std::uint32_t>{ freeSlots });
+
+        snapshot::for_each_run(occupancy_, [&](std::size_t first, std::size_t count) { storage_.save(out, first, count); });
+    }
+
+    template <ComponentConcept Component, std::size_t CAPACITY>
+    std::vector<PooledComponent<Component, CAPACITY>> ComponentPool<Component, CAPACITY>::load(std::istream& in) noexcept(false)
+    {
+        if (highWater_.load(std::memory_order_relaxed) != 0U)
+        {
+            throw snapshot_exception{ "snapshot: only a freshly constructed pool may be loaded." };
+        }
+
+        const std::uint32_t highWater{ snapshot::read<std::uint32_t>(in) };
+        const std::uint64_t size{ snapshot::read<std::uint64_t>(in) };
+        if (highWater > CAPACITY || size > highWater)
+        {
+            throw snapshot_exception{ "snapshot: a component pool's counts exceed its capacity." };
+        }
+        snapshot::read_occupancy(in, occupancy_, highWater, size);
+
+        if (snapshot::read<std::uint64_t>(in) != highWater - size)
+        {
+            throw snapshot_exception{ "snapshot: a component pool's free slots don't add up." };
+        }
+        std::vector<std::uint32_t> freeSlots(highWater - size);
+        snapshot::read(in, std::span<std::uint32_t>{ freeSlots });
+
+        // relink the stack bottom up, a duplicate slot would make it hand the slot out twice
+        std::vector<bool> stacked(highWater);
+        std::uint64_t next{ CAPACITY };
+        for (auto freeSlot{ freeSlots.rbegin() }; freeSlot != freeSlots.rend(); ++freeSlot)
+        {
+            if (*freeSlot >= highWater || occupancy_.test(*freeSlot) || stacked[*freeSlot])
+            {
+                throw snapshot_exception{ "snapshot: a component pool's free slot is out of range, live or repeated." };
+            }
+            stacked[*freeSlot] = true;
+            nextFree(*freeSlot).store(static_cast<std::uint32_t>(next), std::memory_order_relaxed);
+            next = *freeSlot;
+        }
+
+        snapshot::for_each_run(occupancy_, [&](std::size_t first, std::size_t count) { storage_.load(in, first, count); });
+
+        highWater_.store(highWater, std::memory_order_relaxed);
+        size_.store(size, std::memory_order_relaxed);
+        stackTop_.store(makeTop(next, stackTop_.load(std::memory_order_relaxed)), std::memory_order_release);
+
+        std::vector<PooledComponent<Component, CAPACITY>> compos{};
+        compos.reserve(size);
+        for (const std::size_t slot : occupancy_)
+        {
+            owners_[slot] = noOwner;
+            compos.emplace_back(storage_.pointerTo(slot), compoDeleter_);
+        }
+
+        return compos;
     }
 }
 
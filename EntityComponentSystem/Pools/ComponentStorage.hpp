@@ -0,0 +1,443 @@
+#ifndef COMPONENT_STORAGE
+#define COMPONENT_STORAGE
+
+#include "SoaLayout.hpp"
+#include "Snapshot.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace ecs
+{
+    template <typename Member>
+    struct member_traits;
+
+    template <typename Class, typename Field>
+    struct member_traits<Field Class::*>
+    {
+        using field_type = Field;
+    };
+
+
+    // Array-of-structs storage, components are handed out as plain pointers.
+    template <typename Component, std::size_t CAPACITY>
+    class AosStorage
+    {
+    public:
+        using pointer = Component*;
+        using reference = Component&;
+
+        [[nodiscard]] pointer construct(std::size_t slot) noexcept;
+
+        [[nodiscard]] std::size_t slotOf(pointer compo) const noexcept;
+
+        [[nodiscard]] Component& at(std::size_t slot) noexcept;
+
+        [[nodiscard]] Component* data() noexcept;
+
+        // the pointer construct(slot) handed out, for a slot whose component is already in place
+        [[nodiscard]] pointer pointerTo(std::size_t slot) noexcept;
+
+        // the raw bytes of slots [first, first + count), see Snapshot.hpp
+        void save(std::ostream& out, std::size_t first, std::size_t count) const noexcept(false);
+
+        void load(std::istream& in, std::size_t first, std::size_t count) noexcept(false);
+
+    private:
+        // raw bytes rather than an array of Component, which would run the component's member initializers on every slot.
+        // construct() initializes a slot when it's handed out, so the pages of slots never handed out are never written
+        alignas(64) alignas(Component) std::byte data_[sizeof(Component) * CAPACITY];
+
+        [[nodiscard]] Component* slots() noexcept;
+
+        [[nodiscard]] const Component* slots() const noexcept;
+    };
+
+
+    template <typename Component, std::size_t CAPACITY>
+    class SoaStorage;
+
+    // What SoaPointer's -> and * yield: soa_layout's struct of references, bound to a single slot of each column.
+    // Nothing is copied, so "pooledCompo->a += pooledCompo->b" or "(*compo).a += (*compo).b" reads b and writes a
+    // right in their columns, and touches no other field.
+    // A whole component may still be copied out of or into the slot, "Component copy = *compo" and "*compo = copy"
+    template <typename Component, std::size_t CAPACITY>
+    class SoaReference : public soa_layout<Component>::reference
+    {
+    public:
+        SoaReference(SoaStorage<Component, CAPACITY>* storage, std::size_t slot) noexcept;
+
+        SoaReference(const SoaReference&) noexcept = default;
+
+        [[nodiscard]] typename soa_layout<Component>::reference* operator->() noexcept;
+
+        // gathers the slot's fields from every column
+        [[nodiscard]] operator Component() const noexcept;
+
+        // scatters compo's fields to every column
+        SoaReference& operator=(const Component& compo) noexcept;
+
+    private:
+        SoaStorage<Component, CAPACITY>* storage_;
+        std::size_t slot_;
+    };
+
+
+    // The fancy pointer PooledComponent holds for SoA components,
+    // so "pooledCompo->field" keeps working although there's no Component object to point to.
+    // NOTE: std::unique_ptr's * must yield a Component&, so a PooledComponent is dereferenced through its pointer,
+    // "*pooledCompo.get()"
+    template <typename Component, std::size_t CAPACITY>
+    class SoaPointer
+    {
+    public:
+        SoaPointer() noexcept = default;
+
+        SoaPointer(std::nullptr_t) noexcept;
+
+        SoaPointer(SoaStorage<Component, CAPACITY>* storage, std::size_t slot) noexcept;
+
+        [[nodiscard]] SoaReference<Component, CAPACITY> operator->() const noexcept;
+
+        [[nodiscard]] SoaReference<Component, CAPACITY> operator*() const noexcept;
+
+        [[nodiscard]] std::size_t slot() const noexcept;
+
+        [[nodiscard]] explicit operator bool() const noexcept;
+
+        [[nodiscard]] bool operator==(const SoaPointer& other) const noexcept = default;
+
+        [[nodiscard]] auto operator<=>(const SoaPointer& other) const noexcept = default;
+
+        [[nodiscard]] bool operator==(std::nullptr_t) const noexcept;
+
+    private:
+        SoaStorage<Component, CAPACITY>* storage_{ nullptr };
+        std::size_t slot_{ 0U };
+    };
+
+
+    // Structure-of-arrays storage, one cache line aligned column per field listed in soa_layout.
+    template <typename Component, std::size_t CAPACITY>
+    class SoaStorage
+    {
+        static constexpr auto fields_s{ soa_layout<Component>::fields };
+        static constexpr std::size_t fieldsCount_s{ std::tuple_size_v<decltype(fields_s)> };
+
+        template <std::size_t I>
+        using FieldType = typename member_traits<std::remove_cvref_t<decltype(std::get<I>(fields_s))>>::field_type;
+
+        template <typename Field>
+        struct alignas(64) Column
+        {
+            // user provided, so value initializing columns_ leaves data_ uninitialized,
+            // construct() initializes a slot when it's handed out
+            Column() noexcept { }
+
+            std::array<Field, CAPACITY> data_;
+        };
+
+        template <std::size_t... Is>
+        static auto makeColumns(std::index_sequence<Is...>) -> std::tuple<Column<FieldType<Is>>...>;
+
+        static consteval std::size_t fieldsSize() noexcept;
+
+        template <auto Member>
+        static consteval std::size_t fieldIndex() noexcept;
+
+        static_assert(fieldsSize() == sizeof(Component), "soa_layout must list every data member of the component");
+        static_assert(std::is_aggregate_v<typename soa_layout<Component>::reference> &&
+            sizeof(typename soa_layout<Component>::reference) == fieldsCount_s * sizeof(void*),
+            "soa_layout's reference must hold a reference to every field, in the order of fields");
+
+    public:
+        using pointer = SoaPointer<Component, CAPACITY>;
+        using reference = SoaReference<Component, CAPACITY>;
+
+        [[nodiscard]] pointer construct(std::size_t slot) noexcept;
+
+        [[nodiscard]] std::size_t slotOf(pointer compo) const noexcept;
+
+        // copies of a whole component, gathered from or scattered to every column
+        [[nodiscard]] Component load(std::size_t slot) const noexcept;
+
+        void store(std::size_t slot, const Component& compo) noexcept;
+
+        // references to the slot's field in each column
+        [[nodiscard]] typename soa_layout<Component>::reference fieldsAt(std::size_t slot) noexcept;
+
+        template <auto Member>
+        [[nodiscard]] auto column() noexcept;
+
+        // the pointer construct(slot) handed out, for a slot whose component is already in place
+        [[nodiscard]] pointer pointerTo(std::size_t slot) noexcept;
+
+        // slots [first, first + count) of each column in turn, see Snapshot.hpp
+        void save(std::ostream& out, std::size_t first, std::size_t count) const noexcept(false);
+
+        void load(std::istream& in, std::size_t first, std::size_t count) noexcept(false);
+
+    private:
+        decltype(makeColumns(std::make_index_sequence<fieldsCount_s>{})) columns_;
+    };
+
+
+    template <typename Component, std::size_t CAPACITY>
+    struct storage_for
+    {
+        using type = AosStorage<Component, CAPACITY>;
+    };
+
+    template <SoaComponent Component, std::size_t CAPACITY>
+    struct storage_for<Component, CAPACITY>
+    {
+        using type = SoaStorage<Component, CAPACITY>;
+    };
+
+    template <typename Component, std::size_t CAPACITY>
+    using ComponentStorage = typename storage_for<Component, CAPACITY>::type;
+
+
+    //////// AosStorage definitions //////// 
+    template <typename Component, std::size_t CAPACITY>
+    AosStorage<Component, CAPACITY>::pointer AosStorage<Component, CAPACITY>::construct(std::size_t slot) noexcept
+    {
+        return new (slots() + slot) Component{};
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    std::size_t AosStorage<Component, CAPACITY>::slotOf(pointer compo) const noexcept
+    {
+        return static_cast<std::size_t>(compo - slots());
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    Component& AosStorage<Component, CAPACITY>::at(std::size_t slot) noexcept
+    {
+        return slots()[slot];
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    Component* AosStorage<Component, CAPACITY>::data() noexcept
+    {
+        return slots();
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    AosStorage<Component, CAPACITY>::pointer AosStorage<Component, CAPACITY>::pointerTo(std::size_t slot) noexcept
+    {
+        return slots() + slot;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    void AosStorage<Component, CAPACITY>::save(std::ostream& out, std::size_t first, std::size_t count) const noexcept(false)
+    {
+        snapshot::write(out, std::span<const std::byte>{ data_ + first * sizeof(Component), count * sizeof(Component) });
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    void AosStorage<Component, CAPACITY>::load(std::istream& in, std::size_t first, std::size_t count) noexcept(false)
+    {
+        // the bytes read implicitly create the components, as construct() would have
+        snapshot::read(in, std::span<std::byte>{ data_ + first * sizeof(Component), count * sizeof(Component) });
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    Component* AosStorage<Component, CAPACITY>::slots() noexcept
+    {
+        // components are trivially copyable, so implicitly created in data_
+        return std::launder(reinterpret_cast<Component*>(data_));
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    const Component* AosStorage<Component, CAPACITY>::slots() const noexcept
+    {
+        return std::launder(reinterpret_cast<const Component*>(data_));
+    }
+
+    //////// SoaReference definitions //////// 
+    template <typename Component, std::size_t CAPACITY>
+    SoaReference<Component, CAPACITY>::SoaReference(SoaStorage<Component, CAPACITY>* storage, std::size_t slot) noexcept
+        : soa_layout<Component>::reference{ storage->fieldsAt(slot) }
+        , storage_{ storage }
+        , slot_{ slot }
+    { }
+
+    template <typename Component, std::size_t CAPACITY>
+    typename soa_layout<Component>::reference* SoaReference<Component, CAPACITY>::operator->() noexcept
+    {
+        return this;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaReference<Component, CAPACITY>::operator Component() const noexcept
+    {
+        return storage_->load(slot_);
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaReference<Component, CAPACITY>& SoaReference<Component, CAPACITY>::operator=(const Component& compo) noexcept
+    {
+        storage_->store(slot_, compo);
+        return *this;
+    }
+
+    //////// SoaPointer definitions //////// 
+    template <typename Component, std::size_t CAPACITY>
+    SoaPointer<Component, CAPACITY>::SoaPointer(std::nullptr_t) noexcept
+    { }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaPointer<Component, CAPACITY>::SoaPointer(SoaStorage<Component, CAPACITY>* storage, std::size_t slot) noexcept
+        : storage_{ storage }
+        , slot_{ slot }
+    { }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaReference<Component, CAPACITY> SoaPointer<Component, CAPACITY>::operator->() const noexcept
+    {
+        return SoaReference<Component, CAPACITY>{ storage_, slot_ };
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaReference<Component, CAPACITY> SoaPointer<Component, CAPACITY>::operator*() const noexcept
+    {
+        return SoaReference<Component, CAPACITY>{ storage_, slot_ };
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    std::size_t SoaPointer<Component, CAPACITY>::slot() const noexcept
+    {
+        return slot_;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaPointer<Component, CAPACITY>::operator bool() const noexcept
+    {
+        return storage_ != nullptr;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    bool SoaPointer<Component, CAPACITY>::operator==(std::nullptr_t) const noexcept
+    {
+        return storage_ == nullptr;
+    }
+
+    //////// SoaStorage definitions //////// 
+    template <typename Component, std::size_t CAPACITY>
+    consteval std::size_t SoaStorage<Component, CAPACITY>::fieldsSize() noexcept
+    {
+        return []<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            return (sizeof(FieldType<Is>) + ... + 0U);
+        }(std::make_index_sequence<fieldsCount_s>{});
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    template <auto Member>
+    consteval std::size_t SoaStorage<Component, CAPACITY>::fieldIndex() noexcept
+    {
+        std::size_t idx{ fieldsCount_s };
+        [&idx]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            // member pointers of different field types can't be compared, so match the type first
+            ([&idx]()
+                {
+                    if constexpr (std::same_as<std::remove_cvref_t<decltype(std::get<Is>(fields_s))>, decltype(Member)>)
+                    {
+                        if (std::get<Is>(fields_s) == Member)
+                        {
+                            idx = Is;
+                        }
+                    }
+                }(), ...);
+        }(std::make_index_sequence<fieldsCount_s>{});
+
+        return idx;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaStorage<Component, CAPACITY>::pointer SoaStorage<Component, CAPACITY>::construct(std::size_t slot) noexcept
+    {
+        store(slot, Component{});
+        return { this, slot };
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    std::size_t SoaStorage<Component, CAPACITY>::slotOf(pointer compo) const noexcept
+    {
+        return compo.slot();
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    Component SoaStorage<Component, CAPACITY>::load(std::size_t slot) const noexcept
+    {
+        Component compo{};
+        [&]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            ((compo.*std::get<Is>(fields_s) = std::get<Is>(columns_).data_[slot]), ...);
+        }(std::make_index_sequence<fieldsCount_s>{});
+
+        return compo;
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    void SoaStorage<Component, CAPACITY>::store(std::size_t slot, const Component& compo) noexcept
+    {
+        [&]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            ((std::get<Is>(columns_).data_[slot] = compo.*std::get<Is>(fields_s)), ...);
+        }(std::make_index_sequence<fieldsCount_s>{});
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    typename soa_layout<Component>::reference SoaStorage<Component, CAPACITY>::fieldsAt(std::size_t slot) noexcept
+    {
+        return [&]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            return typename soa_layout<Component>::reference{ std::get<Is>(columns_).data_[slot]... };
+        }(std::make_index_sequence<fieldsCount_s>{});
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    template <auto Member>
+    auto SoaStorage<Component, CAPACITY>::column() noexcept
+    {
+        constexpr std::size_t idx{ fieldIndex<Member>() };
+        static_assert(idx != fieldsCount_s, "Member isn't listed in the component's soa_layout");
+
+        return std::span<FieldType<idx>, CAPACITY>{ std::get<idx>(columns_).data_ };
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    SoaStorage<Component, CAPACITY>::pointer SoaStorage<Component, CAPACITY>::pointerTo(std::size_t slot) noexcept
+    {
+        return { this, slot };
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    void SoaStorage<Component, CAPACITY>::save(std::ostream& out, std::size_t first, std::size_t count) const noexcept(false)
+    {
+        [&]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            (snapshot::write(out, std::span<const FieldType<Is>>{ std::get<Is>(columns_).data_.data() + first, count }), ...);
+        }(std::make_index_sequence<fieldsCount_s>{});
+    }
+
+    template <typename Component, std::size_t CAPACITY>
+    void SoaStorage<Component, CAPACITY>::load(std::istream& in, std::size_t first, std::size_t count) noexcept(false)
+    {
+        [&]<std::size_t... Is>(std::index_sequence<Is...>)
+        {
+            (snapshot::read(in, std::span<FieldType<Is>>{ std::get<Is>(columns_).data_.data() + first, count }), ...);
+        }(std::make_index_sequence<fieldsCount_s>{});
+    }
+}
+
+#endif // !COMPONENT_STORAGE
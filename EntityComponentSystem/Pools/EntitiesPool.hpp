@@ -2,19 +2,30 @@
 #define ENTITIES_OBJECT_POOL
 
 #include "ComponentPool.hpp"
+#include "Snapshot.hpp"
+#include "Instrumentation.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
 #include <variant>
+#include <vector>
 
 
 namespace ecs
 {
     using EntityId = unsigned long;
 
-    template<std::size_t CAPACITY>
+    template <std::size_t CAPACITY, ComponentConcept... Components>
     using PooledVariant =
         std::variant<std::monostate,
-        PooledComponent<PhysicsComponent, CAPACITY>,
-        PooledComponent<LifetimeComponent, CAPACITY>>;
+        PooledComponent<Components, CAPACITY>...>;
 
 
     enum class Group : std::uint32_t
@@ -31,32 +42,84 @@ namespace ecs
         count
     };
 
-    template<std::size_t CAPACITY>
-    static constexpr std::uint32_t componentClassesCount{ std::variant_size_v<PooledVariant<CAPACITY>> - 1U };
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    static constexpr std::uint32_t componentClassesCount{ std::variant_size_v<PooledVariant<CAPACITY, Components...>> - 1U };
 
     static constexpr std::uint32_t groupsCount{ static_cast<std::underlying_type_t<Group>>(Group::count) - 1U };
 
-    template<std::size_t CAPACITY>
+    // bit (group - 1) is set iff the entity is a member of group
+    using GroupMask = std::uint32_t;
+
+    static_assert(groupsCount <= 32U, "GroupMask holds at most 32 groups");
+
+    // 0 for Group::emptyVal and anything from Group::count on, which no entity is a member of
+    [[nodiscard]] constexpr GroupMask group_bit(Group group) noexcept
+    {
+        return group == Group::emptyVal || group >= Group::count ? GroupMask{ 0U } :
+            GroupMask{ 1U } << (static_cast<std::underlying_type_t<Group>>(group) - 1U);
+    }
+
+    namespace entities_pool_detail
+    {
+        template <typename T, typename... Ts>
+        consteval std::size_t index_of()
+        {
+            constexpr bool matches[]{ std::same_as<T, Ts>... };
+            for (std::size_t i{ 0U }; i != sizeof...(Ts); ++i)
+            {
+                if (matches[i])
+                {
+                    return i;
+                }
+            }
+            return sizeof...(Ts);
+        }
+    }
+
+    // how many times T appears in Ts
+    template <typename T, typename... Ts>
+    inline constexpr std::size_t count_of{ (std::size_t{ 0U } + ... + static_cast<std::size_t>(std::same_as<T, Ts>)) };
+
+    // The slot of Component in EntityBody::components_ is fixed at compile time:
+    // its position in Components, which is also its position in PooledVariant's alternatives after std::monostate
+    template <ComponentConcept Component, ComponentConcept... Components>
+        requires same_as_any_of<Component, Components...>
+    inline constexpr std::size_t componentSlot{ entities_pool_detail::index_of<Component, Components...>() };
+
+    // components_[componentSlot<Component>] is either std::monostate or a PooledComponent<Component>
+    template <std::size_t CAPACITY, ComponentConcept... Components>
     struct EntityBody
     {
         EntityId id_{ 0U };
-        std::array<PooledVariant<CAPACITY>, componentClassesCount<CAPACITY>> components_{};
-        std::array<Group, groupsCount> groups_{};
+        std::array<PooledVariant<CAPACITY, Components...>, componentClassesCount<CAPACITY, Components...>> components_{};
+        GroupMask groups_{ 0U };
     };
 
 
-    template <std::size_t CAPACITY>
+    // A copyable reference to an entity: its body's slot and the generation that slot was at when the entity was requested.
+    // Every release bumps the slot's generation, so a handle outliving its entity is detected with one comparison.
+    // Being trivially copyable it may be stored in components, e.g. a target to follow.
+    struct EntityHandle
+    {
+        std::uint32_t index_{ std::numeric_limits<std::uint32_t>::max() };
+        std::uint32_t generation_{ 0U };
+
+        [[nodiscard]] bool operator==(const EntityHandle& other) const noexcept = default;
+    };
+
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
     class EntitiesPool;
 
-    template <std::size_t CAPACITY>
+    template <std::size_t CAPACITY, ComponentConcept... Components>
     class EntityDeleter
     {
     public:
-        EntityDeleter(EntitiesPool<CAPACITY>& entitiesPool)
+        EntityDeleter(EntitiesPool<CAPACITY, Components...>& entitiesPool)
             : entitiesPool_{ entitiesPool }
         { }
 
-        void operator()(EntityBody<CAPACITY>* entBody) const
+        void operator()(EntityBody<CAPACITY, Components...>* entBody) const
         {
             // NOTE: The pool's lifetime must exceed that of its objects, 
             // otherwise it'll lead to undefined behavior
@@ -65,12 +128,12 @@ namespace ecs
         }
 
     private:
-        EntitiesPool<CAPACITY>& entitiesPool_;
+        EntitiesPool<CAPACITY, Components...>& entitiesPool_;
     };
 
 
-    template<std::size_t CAPACITY>
-    using PooledEntityBody = std::unique_ptr<EntityBody<CAPACITY>, const EntityDeleter<CAPACITY>&>;
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    using PooledEntityBody = std::unique_ptr<EntityBody<CAPACITY, Components...>, const EntityDeleter<CAPACITY, Components...>&>;
 
 
     class entities_max_capacity_exception : public std::bad_alloc
@@ -83,13 +146,34 @@ namespace ecs
     };
 
 
-    template <std::size_t CAPACITY>
+    // Free slots live in the shared stack_, fronted by magazinesCount_s magazines.
+    // A thread claims a magazine of its own on its first request or release and keeps it until it exits,
+    // it requests from and releases to it without any lock, and only locks mutex_ to refill an empty magazine
+    // or to spill an overflowing one, moving magazineBatch_s slots at a time.
+    // Threads past the first magazinesCount_s (at once) go straight to the shared stack_ under mutex_.
+    // When everything else is empty, request() takes the slots left in magazines of threads which exited.
+    // NOTE: up to 2 * magazineBatch_s free slots may sit in the magazine of each other live thread,
+    // so a request may throw before size() reaches CAPACITY while several threads hold magazines
+    template <std::size_t CAPACITY, ComponentConcept... Components>
     class EntitiesPool
     {
     public:
         EntitiesPool() noexcept;
 
-        [[nodiscard]] PooledEntityBody<CAPACITY> request() noexcept(false);
+        EntitiesPool(const EntitiesPool&) = delete;
+        EntitiesPool& operator=(const EntitiesPool&) = delete;
+
+        ~EntitiesPool();
+
+        [[nodiscard]] PooledEntityBody<CAPACITY, Components...> request() noexcept(false);
+
+        // takes count slots while locking the shared stack once,
+        // either all of them are handed out or none (and it throws)
+        [[nodiscard]] std::vector<PooledEntityBody<CAPACITY, Components...>> requestBatch(std::size_t count) noexcept(false);
+
+        // returns all the bodies' slots to the shared stack while locking it once,
+        // leaving the given PooledEntityBodies empty
+        void releaseBatch(std::span<PooledEntityBody<CAPACITY, Components...>> entBodies) noexcept;
 
         [[nodiscard]] consteval std::size_t capacity() const noexcept;
 
@@ -97,105 +181,879 @@ namespace ecs
 
         [[nodiscard]] bool isFull() const noexcept;
 
-        EntityBody<CAPACITY>* begin() noexcept;
+        // all slots, live or not, see occupancy(). Bodies are only constructed in slots which were taken before
+        EntityBody<CAPACITY, Components...>* begin() noexcept;
+
+        EntityBody<CAPACITY, Components...>* end() noexcept;
+
+        [[nodiscard]] const OccupancyBitset<CAPACITY>& occupancy() const noexcept;
+
+        // a range over the live entity bodies only, in slot order.
+        // NOTE: mustn't be iterated while entities are requested or released
+        [[nodiscard]] auto live() noexcept;
+
+        // sets group's bit on the body and appends it to group's member list,
+        // returns false if it already was a member
+        [[nodiscard]] bool enroll(EntityBody<CAPACITY, Components...>* entBody, Group group) noexcept;
+
+        // clears group's bit on the body and swaps it out of group's member list,
+        // returns false if it wasn't a member
+        [[nodiscard]] bool dismiss(EntityBody<CAPACITY, Components...>* entBody, Group group) noexcept;
+
+        // a range over group's members only, in no particular order, empty for Group::emptyVal.
+        // NOTE: mustn't be iterated while entities are enrolled, dismissed or released
+        [[nodiscard]] auto members(Group group) noexcept;
 
-        EntityBody<CAPACITY>* end() noexcept;
+        [[nodiscard]] std::size_t membersCount(Group group) const noexcept;
+
+        // a default EntityHandle, which is never alive, for a body this pool never handed out
+        [[nodiscard]] EntityHandle handleOf(const EntityBody<CAPACITY, Components...>* entBody) const noexcept;
+
+        // whether the handle's entity wasn't released yet, false for a slot this pool never handed out.
+        // NOTE: a handle may go stale right after the check if another thread releases its entity
+        [[nodiscard]] bool isAlive(EntityHandle handle) const noexcept;
+
+        // the handle's entity body, nullptr if it was released
+        [[nodiscard]] EntityBody<CAPACITY, Components...>* get(EntityHandle handle) noexcept;
+
+        // writes the generations, the free slots (shared stack and magazines alike), 
+        // every live body's id and groups and the groups' member lists, see Snapshot.hpp.
+        // Components are left to EntitiesManager::save, which knows their pools.
+        // NOTE: mustn't be called while entities are requested, released, enrolled or dismissed
+        void save(std::ostream& out) const noexcept(false);
+
+        // restores what save() wrote into this freshly constructed pool, so handles taken before the save stay valid
+        // and each magazine hands out the same slots next. 
+        // Returns the live bodies in slot order, without components. If it throws the pool should be discarded
+        [[nodiscard]] std::vector<PooledEntityBody<CAPACITY, Components...>> load(std::istream& in) noexcept(false);
 
     private:
-        friend class EntityDeleter<CAPACITY>;
+        friend class EntityDeleter<CAPACITY, Components...>;
+
+        static constexpr std::size_t magazineBatch_s{ 16U };
+        static constexpr std::size_t magazinesCount_s{ 16U };
+
+        // hands out serial_, so a pool constructed where another one was isn't mistaken for it
+        static std::atomic<std::uint64_t> nextSerial_s;
+
+        // Only its owner touches a claimed magazine, other threads only touch an unclaimed one under mutex_.
+        // Aligned to a cache line so threads don't false share their magazines
+        struct alignas(64) Magazine
+        {
+            std::array<std::size_t, 2U * magazineBatch_s> slots_{};
+            std::size_t count_{ 0U };
+            // guarded by mutex_
+            bool claimed_{ false };
+        };
 
-        std::array<EntityBody<CAPACITY>, CAPACITY> pool_;
-        EntityBody<CAPACITY>* const poolStart_;
+        // outlives the pool while a thread still holds one of its magazines,
+        // so a thread exiting after the pool is destroyed finds pool_ null rather than touching it
+        struct Anchor
+        {
+            explicit Anchor(EntitiesPool* pool) noexcept
+                : pool_{ pool }
+            { }
+
+            std::mutex mutex_{};
+            EntitiesPool* pool_;
+        };
+
+        // the magazines the current thread claimed, handed back to their pools when it exits
+        class ThreadMagazines
+        {
+        public:
+            ThreadMagazines() noexcept = default;
+
+            ThreadMagazines(const ThreadMagazines&) = delete;
+            ThreadMagazines& operator=(const ThreadMagazines&) = delete;
+
+            ~ThreadMagazines();
+
+            // nullptr if the thread holds no magazine of pool
+            [[nodiscard]] Magazine* find(const EntitiesPool* pool, std::uint64_t serial) const noexcept;
+
+            // false if the claim couldn't be recorded
+            [[nodiscard]] bool add(const EntitiesPool* pool, std::uint64_t serial, Magazine* magazine, const std::shared_ptr<Anchor>& anchor) noexcept;
+
+        private:
+            struct Claim
+            {
+                const EntitiesPool* pool_;
+                std::uint64_t serial_;
+                Magazine* magazine_;
+                std::weak_ptr<Anchor> anchor_;
+            };
+
+            std::vector<Claim> claims_{};
+        };
+
+        // raw storage, a body is constructed the first time its slot is taken, see takeFree
+        alignas(EntityBody<CAPACITY, Components...>) std::byte pool_[sizeof(EntityBody<CAPACITY, Components...>) * CAPACITY];
+        EntityBody<CAPACITY, Components...>* const poolStart_;
+        // free slots are stack_[stackTop_, CAPACITY), slots from highWater_ on were never taken and aren't stacked.
+        // highWater_ is only raised under mutex_, it's atomic so isAlive can tell which generations are initialized
         std::array<std::size_t, CAPACITY> stack_;
         std::size_t stackTop_;
-        std::size_t size_;
+        std::atomic<std::size_t> highWater_;
+        std::atomic<std::size_t> size_;
         std::mutex mutex_;
-        const EntityDeleter<CAPACITY> entDeleter_;
+        std::array<Magazine, magazinesCount_s> magazines_;
+        const std::uint64_t serial_;
+        // created with the first claim, guarded by mutex_
+        std::shared_ptr<Anchor> anchor_;
+        OccupancyBitset<CAPACITY> occupancy_;
+        const EntityDeleter<CAPACITY, Components...> entDeleter_;
+
+        // the dense list of a group's members (body slots),
+        // positions_[slot] is where body slot sits in slots_, so dismissing is a swap with the last member
+        struct GroupMembers
+        {
+            std::mutex mutex_{};
+            std::array<std::uint32_t, CAPACITY> slots_;
+            std::array<std::uint32_t, CAPACITY> positions_;
+            std::size_t count_{ 0U };
+        };
+
+        std::array<GroupMembers, groupsCount> groupMembers_;
+
+        // bumped whenever the slot is released, see EntityHandle.
+        // Accessed through std::atomic_ref, a plain array is left uninitialized until a slot is first taken
+        std::array<std::uint32_t, CAPACITY> generations_;
+
+        [[nodiscard]] std::atomic_ref<std::uint32_t> generation(std::size_t slot) noexcept;
+
+        [[nodiscard]] std::atomic_ref<const std::uint32_t> generation(std::size_t slot) const noexcept;
+
+        // pops a slot off the shared stack, or else takes the next untouched one.
+        // mutex_ must be held
+        [[nodiscard]] bool takeFree(std::size_t& slot) noexcept;
 
-        void release(EntityBody<CAPACITY>* entBody) noexcept;
+        // dismisses a body which is being released from every group it's a member of
+        void dismissAll(EntityBody<CAPACITY, Components...>* entBody) noexcept;
+
+        void release(EntityBody<CAPACITY, Components...>* entBody) noexcept;
+
+        // the current thread's magazine, claimed on its first call. nullptr if every magazine is claimed
+        [[nodiscard]] Magazine* ownMagazine() noexcept;
+
+        [[nodiscard]] Magazine* claim(ThreadMagazines& threadMagazines) noexcept;
+
+        void unclaim(Magazine& magazine) noexcept;
+
+        void refill(Magazine& magazine) noexcept;
+
+        void spill(Magazine& magazine) noexcept;
+
+        // takes a slot from the magazine of a thread which exited
+        [[nodiscard]] bool steal(std::size_t& slot) noexcept;
+
+        [[nodiscard]] static ThreadMagazines& threadMagazines() noexcept;
     };
 
 
-    template <std::size_t CAPACITY>
-    EntitiesPool<CAPACITY>::EntitiesPool() noexcept
-        : pool_{}
-        , poolStart_{ pool_.data() }
-        , stack_{}
-        , stackTop_{ 0U }
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::atomic<std::uint64_t> EntitiesPool<CAPACITY, Components...>::nextSerial_s{ 0U };
+
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntitiesPool<CAPACITY, Components...>::EntitiesPool() noexcept
+        // pool_, stack_, groupMembers_' lists and generations_ are left default initialized,
+        // so no page of them is touched before a slot in it is taken
+        : poolStart_{ reinterpret_cast<EntityBody<CAPACITY, Components...>*>(pool_) }
+        , stackTop_{ CAPACITY }
+        , highWater_{ 0U }
         , size_{ 0U }
         , mutex_{}
+        , magazines_{}
+        , serial_{ nextSerial_s.fetch_add(1U, std::memory_order_relaxed) }
+        , anchor_{}
+        , occupancy_{}
         , entDeleter_{ *this }
+    { }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntitiesPool<CAPACITY, Components...>::~EntitiesPool()
     {
-        for (std::size_t i{ 0U }; i != CAPACITY; ++i)
+        if (anchor_ != nullptr)
+        {
+            std::lock_guard anchorLock{ anchor_->mutex_ };
+            anchor_->pool_ = nullptr;
+        }
+
+        for (std::size_t i{ 0U }; i != highWater_.load(std::memory_order_relaxed); ++i)
         {
-            stack_[i] = i;
+            poolStart_[i].~EntityBody();
         }
     }
 
-    template <std::size_t CAPACITY>
-    PooledEntityBody<CAPACITY> EntitiesPool<CAPACITY>::request() noexcept(false)
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    PooledEntityBody<CAPACITY, Components...> EntitiesPool<CAPACITY, Components...>::request() noexcept(false)
     {
-        std::lock_guard lock{ mutex_ };
+        std::size_t slot{ CAPACITY };
+        if (Magazine* const magazine{ ownMagazine() }; magazine != nullptr) [[likely]]
+        {
+            if (magazine->count_ == 0U)
+            {
+                refill(*magazine);
+            }
 
-        if (stackTop_ == CAPACITY) [[unlikely]]
+            if (magazine->count_ != 0U) [[likely]]
+            {
+                --magazine->count_;
+                slot = magazine->slots_[magazine->count_];
+            }
+        }
+        else
+        {
+            const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+            static_cast<void>(takeFree(slot));
+        }
+
+        // both our magazine and the shared stack are empty, 
+        // the remaining free slots (if any) are cached by other threads
+        if (slot == CAPACITY && !steal(slot)) [[unlikely]]
         {
             throw entities_max_capacity_exception{};
         }
 
-        ++stackTop_;
+        size_.fetch_add(1U, std::memory_order_relaxed);
 
-        ++size_;
+        EntityBody<CAPACITY, Components...>* entBody{ new (poolStart_ + slot) EntityBody<CAPACITY, Components...>{} };
+        occupancy_.set(slot);
         
-        return { new (&pool_[stack_[stackTop_ - 1U]]) EntityBody<CAPACITY>{}, entDeleter_ };
+        return { entBody, entDeleter_ };
     }
 
-    template <std::size_t CAPACITY>
-    void EntitiesPool<CAPACITY>::release(EntityBody<CAPACITY>* entBody) noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::release(EntityBody<CAPACITY, Components...>* entBody) noexcept
     {
-        std::lock_guard lock{ mutex_ };
-
         const std::size_t freedObjIdx{ static_cast<std::size_t>(entBody - poolStart_) };
 
-        for (PooledVariant<CAPACITY>& component : entBody->components_)
+        dismissAll(entBody);
+        generation(freedObjIdx).fetch_add(1U, std::memory_order_release);
+
+        for (PooledVariant<CAPACITY, Components...>& component : entBody->components_)
         {
             component = std::move(std::monostate{});
         }
 
-        --stackTop_;
-        stack_[stackTop_] = freedObjIdx;
+        occupancy_.reset(freedObjIdx);
+        size_.fetch_sub(1U, std::memory_order_relaxed);
+
+        Magazine* const magazine{ ownMagazine() };
+        if (magazine == nullptr) [[unlikely]]
+        {
+            const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+            --stackTop_;
+            stack_[stackTop_] = freedObjIdx;
+            return;
+        }
+
+        if (magazine->count_ == magazine->slots_.size())
+        {
+            spill(*magazine);
+        }
+
+        magazine->slots_[magazine->count_] = freedObjIdx;
+        ++magazine->count_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::vector<PooledEntityBody<CAPACITY, Components...>> EntitiesPool<CAPACITY, Components...>::requestBatch(std::size_t count) noexcept(false)
+    {
+        std::vector<std::size_t> slots{};
+        slots.reserve(count);
+        {
+            if (Magazine* const magazine{ ownMagazine() }; magazine != nullptr)
+            {
+                while (slots.size() != count && magazine->count_ != 0U)
+                {
+                    --magazine->count_;
+                    slots.push_back(magazine->slots_[magazine->count_]);
+                }
+            }
+
+            const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+            std::size_t slot{ CAPACITY };
+            while (slots.size() != count && takeFree(slot))
+            {
+                slots.push_back(slot);
+            }
+        }
+
+        std::size_t slot{ CAPACITY };
+        while (slots.size() != count && steal(slot))
+        {
+            slots.push_back(slot);
+        }
+
+        if (slots.size() != count) [[unlikely]]
+        {
+            const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+            for (const std::size_t takenSlot : slots)
+            {
+                --stackTop_;
+                stack_[stackTop_] = takenSlot;
+            }
+
+            throw entities_max_capacity_exception{};
+        }
+
+        size_.fetch_add(count, std::memory_order_relaxed);
+
+        std::vector<PooledEntityBody<CAPACITY, Components...>> entBodies{};
+        entBodies.reserve(count);
+        for (const std::size_t takenSlot : slots)
+        {
+            entBodies.emplace_back(new (poolStart_ + takenSlot) EntityBody<CAPACITY, Components...>{}, entDeleter_);
+            occupancy_.set(takenSlot);
+        }
+
+        return entBodies;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::releaseBatch(std::span<PooledEntityBody<CAPACITY, Components...>> entBodies) noexcept
+    {
+        std::size_t count{ 0U };
+        for (PooledEntityBody<CAPACITY, Components...>& pooledBody : entBodies)
+        {
+            if (pooledBody)
+            {
+                dismissAll(pooledBody.get());
+                generation(static_cast<std::size_t>(pooledBody.get() - poolStart_)).fetch_add(1U, std::memory_order_release);
+
+                for (PooledVariant<CAPACITY, Components...>& component : pooledBody->components_)
+                {
+                    component = std::move(std::monostate{});
+                }
+                ++count;
+            }
+        }
+
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+
+        for (PooledEntityBody<CAPACITY, Components...>& pooledBody : entBodies)
+        {
+            if (EntityBody<CAPACITY, Components...>* entBody{ pooledBody.release() })
+            {
+                const std::size_t freedObjIdx{ static_cast<std::size_t>(entBody - poolStart_) };
+                occupancy_.reset(freedObjIdx);
+
+                --stackTop_;
+                stack_[stackTop_] = freedObjIdx;
+            }
+        }
+
+        size_.fetch_sub(count, std::memory_order_relaxed);
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    typename EntitiesPool<CAPACITY, Components...>::Magazine* EntitiesPool<CAPACITY, Components...>::ownMagazine() noexcept
+    {
+        ThreadMagazines& claimed{ threadMagazines() };
+        if (Magazine* const magazine{ claimed.find(this, serial_) }; magazine != nullptr) [[likely]]
+        {
+            return magazine;
+        }
+        return claim(claimed);
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    typename EntitiesPool<CAPACITY, Components...>::Magazine* EntitiesPool<CAPACITY, Components...>::claim(ThreadMagazines& claimed) noexcept
+    {
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+
+        const auto magazine{ std::ranges::find_if(magazines_, [](const Magazine& mag) { return !mag.claimed_; }) };
+        if (magazine == magazines_.end())
+        {
+            return nullptr;
+        }
+
+        if (anchor_ == nullptr)
+        {
+            try
+            {
+                anchor_ = std::make_shared<Anchor>(this);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return nullptr;
+            }
+        }
+
+        if (!claimed.add(this, serial_, &*magazine, anchor_))
+        {
+            return nullptr;
+        }
+
+        magazine->claimed_ = true;
+        return &*magazine;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::unclaim(Magazine& magazine) noexcept
+    {
+        // its slots stay in it, for the next thread claiming it or for steal
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+        magazine.claimed_ = false;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::refill(Magazine& magazine) noexcept
+    {
+        // magazine is the calling thread's own
+
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+
+        std::size_t slot{ CAPACITY };
+        while (magazine.count_ != magazineBatch_s && takeFree(slot))
+        {
+            magazine.slots_[magazine.count_] = slot;
+            ++magazine.count_;
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::spill(Magazine& magazine) noexcept
+    {
+        // magazine is the calling thread's own
+
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+
+        for (std::size_t i{ 0U }; i != magazineBatch_s; ++i)
+        {
+            --magazine.count_;
+            --stackTop_;
+            stack_[stackTop_] = magazine.slots_[magazine.count_];
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::steal(std::size_t& slot) noexcept
+    {
+        // claimed magazines belong to their threads, unclaimed ones are only touched under mutex_
+        const auto lock{ instrumentation::timed_lock(mutex_, "EntitiesPool") };
+
+        for (Magazine& magazine : magazines_)
+        {
+            if (!magazine.claimed_ && magazine.count_ != 0U)
+            {
+                --magazine.count_;
+                slot = magazine.slots_[magazine.count_];
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    typename EntitiesPool<CAPACITY, Components...>::ThreadMagazines& EntitiesPool<CAPACITY, Components...>::threadMagazines() noexcept
+    {
+        thread_local ThreadMagazines claimed{};
+        return claimed;
+    }
+
+    //////// ThreadMagazines definitions //////// 
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntitiesPool<CAPACITY, Components...>::ThreadMagazines::~ThreadMagazines()
+    {
+        for (Claim& claim : claims_)
+        {
+            if (const std::shared_ptr<Anchor> anchor{ claim.anchor_.lock() }; anchor != nullptr)
+            {
+                // the pool can't be destroyed while anchor's mutex is held
+                std::lock_guard anchorLock{ anchor->mutex_ };
+                if (anchor->pool_ != nullptr)
+                {
+                    anchor->pool_->unclaim(*claim.magazine_);
+                }
+            }
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    typename EntitiesPool<CAPACITY, Components...>::Magazine* EntitiesPool<CAPACITY, Components...>::ThreadMagazines::find(
+        const EntitiesPool* pool, std::uint64_t serial) const noexcept
+    {
+        // the latest claims first, they're the likeliest to be used
+        for (auto claim{ claims_.rbegin() }; claim != claims_.rend(); ++claim)
+        {
+            if (claim->pool_ == pool && claim->serial_ == serial)
+            {
+                return claim->magazine_;
+            }
+        }
+        return nullptr;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::ThreadMagazines::add(
+        const EntitiesPool* pool, std::uint64_t serial, Magazine* magazine, const std::shared_ptr<Anchor>& anchor) noexcept
+    {
+        // claims of pools destroyed since are dropped
+        std::erase_if(claims_, [](const Claim& claim) { return claim.anchor_.expired(); });
 
-        --size_;
+        try
+        {
+            claims_.push_back(Claim{ pool, serial, magazine, anchor });
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+        return true;
     }
 
-    template <std::size_t CAPACITY>
-    consteval std::size_t EntitiesPool<CAPACITY>::capacity() const noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    consteval std::size_t EntitiesPool<CAPACITY, Components...>::capacity() const noexcept
     {
         return CAPACITY;
     }
 
-    template <std::size_t CAPACITY>
-    std::size_t EntitiesPool<CAPACITY>::size() const noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::size_t EntitiesPool<CAPACITY, Components...>::size() const noexcept
     {
-        return size_;
+        return size_.load(std::memory_order_relaxed);
     }
 
-    template <std::size_t CAPACITY>
-    bool EntitiesPool<CAPACITY>::isFull() const noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::isFull() const noexcept
     {
-        return size_ == CAPACITY;
+        return size() == CAPACITY;
     }
 
-    template <std::size_t CAPACITY>
-    EntityBody<CAPACITY>* EntitiesPool<CAPACITY>::begin() noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntityBody<CAPACITY, Components...>* EntitiesPool<CAPACITY, Components...>::begin() noexcept
     {
         return poolStart_;
     }
 
-    template <std::size_t CAPACITY>
-    EntityBody<CAPACITY>* EntitiesPool<CAPACITY>::end() noexcept
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntityBody<CAPACITY, Components...>* EntitiesPool<CAPACITY, Components...>::end() noexcept
     {
         return poolStart_ + CAPACITY;
     }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    const OccupancyBitset<CAPACITY>& EntitiesPool<CAPACITY, Components...>::occupancy() const noexcept
+    {
+        return occupancy_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    auto EntitiesPool<CAPACITY, Components...>::live() noexcept
+    {
+        return std::ranges::subrange{ occupancy_.begin(), occupancy_.end() } |
+            std::views::transform([this](std::size_t slot) -> EntityBody<CAPACITY, Components...>& { return poolStart_[slot]; });
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::enroll(EntityBody<CAPACITY, Components...>* entBody, Group group) noexcept
+    {
+        const GroupMask bit{ group_bit(group) };
+        if (bit == 0U || (entBody->groups_ & bit) != 0U)
+        {
+            return false;
+        }
+        entBody->groups_ |= bit;
+
+        const std::uint32_t slot{ static_cast<std::uint32_t>(entBody - poolStart_) };
+        GroupMembers& members{ groupMembers_[std::countr_zero(bit)] };
+        const auto lock{ instrumentation::timed_lock(members.mutex_, "EntitiesPool group") };
+
+        members.positions_[slot] = static_cast<std::uint32_t>(members.count_);
+        members.slots_[members.count_] = slot;
+        ++members.count_;
+
+        return true;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::dismiss(EntityBody<CAPACITY, Components...>* entBody, Group group) noexcept
+    {
+        const GroupMask bit{ group_bit(group) };
+        if ((entBody->groups_ & bit) == 0U)
+        {
+            return false;
+        }
+        entBody->groups_ &= ~bit;
+
+        const std::uint32_t slot{ static_cast<std::uint32_t>(entBody - poolStart_) };
+        GroupMembers& members{ groupMembers_[std::countr_zero(bit)] };
+        const auto lock{ instrumentation::timed_lock(members.mutex_, "EntitiesPool group") };
+
+        --members.count_;
+        const std::uint32_t last{ members.slots_[members.count_] };
+        const std::uint32_t position{ members.positions_[slot] };
+        members.slots_[position] = last;
+        members.positions_[last] = position;
+
+        return true;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::dismissAll(EntityBody<CAPACITY, Components...>* entBody) noexcept
+    {
+        for (GroupMask groups{ entBody->groups_ }; groups != 0U; groups &= groups - 1U)
+        {
+            static_cast<void>(dismiss(entBody, static_cast<Group>(std::countr_zero(groups) + 1)));
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    auto EntitiesPool<CAPACITY, Components...>::members(Group group) noexcept
+    {
+        std::span<const std::uint32_t> slots{};
+        if (const GroupMask bit{ group_bit(group) }; bit != 0U)
+        {
+            const GroupMembers& groupMembers{ groupMembers_[std::countr_zero(bit)] };
+            slots = std::span<const std::uint32_t>{ groupMembers.slots_.data(), groupMembers.count_ };
+        }
+        return slots |
+            std::views::transform([this](std::uint32_t slot) -> EntityBody<CAPACITY, Components...>& { return poolStart_[slot]; });
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::size_t EntitiesPool<CAPACITY, Components...>::membersCount(Group group) const noexcept
+    {
+        const GroupMask bit{ group_bit(group) };
+        return bit == 0U ? 0U : groupMembers_[std::countr_zero(bit)].count_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntityHandle EntitiesPool<CAPACITY, Components...>::handleOf(const EntityBody<CAPACITY, Components...>* entBody) const noexcept
+    {
+        const std::ptrdiff_t slot{ entBody - poolStart_ };
+        if (slot < 0 || static_cast<std::size_t>(slot) >= highWater_.load(std::memory_order_acquire))
+        {
+            return EntityHandle{};
+        }
+        return EntityHandle{ static_cast<std::uint32_t>(slot), generation(static_cast<std::size_t>(slot)).load(std::memory_order_acquire) };
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::isAlive(EntityHandle handle) const noexcept
+    {
+        // generations are only initialized below highWater_
+        return handle.index_ < highWater_.load(std::memory_order_acquire) &&
+            generation(handle.index_).load(std::memory_order_acquire) == handle.generation_;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    EntityBody<CAPACITY, Components...>* EntitiesPool<CAPACITY, Components...>::get(EntityHandle handle) noexcept
+    {
+        return isAlive(handle) ? poolStart_ + handle.index_ : nullptr;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::atomic_ref<std::uint32_t> EntitiesPool<CAPACITY, Components...>::generation(std::size_t slot) noexcept
+    {
+        return std::atomic_ref<std::uint32_t>{ generations_[slot] };
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::atomic_ref<const std::uint32_t> EntitiesPool<CAPACITY, Components...>::generation(std::size_t slot) const noexcept
+    {
+        return std::atomic_ref<const std::uint32_t>{ generations_[slot] };
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    bool EntitiesPool<CAPACITY, Components...>::takeFree(std::size_t& slot) noexcept
+    {
+        if (stackTop_ != CAPACITY)
+        {
+            slot = stack_[stackTop_];
+            ++stackTop_;
+            return true;
+        }
+
+        slot = highWater_.load(std::memory_order_relaxed);
+        if (slot == CAPACITY)
+        {
+            return false;
+        }
+
+        new (poolStart_ + slot) EntityBody<CAPACITY, Components...>{};
+        generation(slot).store(0U, std::memory_order_relaxed);
+        // publishes the generation to isAlive
+        highWater_.store(slot + 1U, std::memory_order_release);
+        return true;
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    void EntitiesPool<CAPACITY, Components...>::save(std::ostream& out) const noexcept(false)
+    {
+        const auto writeSlots{ [&out](std::span<const std::size_t> slots)
+            {
+                std::vector<std::uint32_t> narrowed(slots.begin(), slots.end());
+                snapshot::write(out, static_cast<std::uint64_t>(narrowed.size()));
+                snapshot::write(out, std::span<const std::uint32_t>{ narrowed });
+            } };
+
+        const std::size_t highWater{ highWater_.load(std::memory_order_acquire) };
+        snapshot::write(out, static_cast<std::uint64_t>(highWater));
+        snapshot::write(out, static_cast<std::uint64_t>(size()));
+        snapshot::write(out, std::span<const std::uint32_t>{ generations_.data(), highWater });
+        snapshot::write_occupancy(out, occupancy_, highWater);
+
+        // every slot below highWater_ which isn't live is either on the shared stack or in a magazine
+        writeSlots(std::span<const std::size_t>{ stack_.data() + stackTop_, CAPACITY - stackTop_ });
+        snapshot::write(out, static_cast<std::uint64_t>(magazinesCount_s));
+        for (const Magazine& magazine : magazines_)
+        {
+            writeSlots(std::span<const std::size_t>{ magazine.slots_.data(), magazine.count_ });
+        }
+
+        std::vector<std::uint64_t> ids{};
+        std::vector<GroupMask> groups{};
+        ids.reserve(size());
+        groups.reserve(size());
+        for (const std::size_t slot : occupancy_)
+        {
+            ids.push_back(poolStart_[slot].id_);
+            groups.push_back(poolStart_[slot].groups_);
+        }
+        snapshot::write(out, std::span<const std::uint64_t>{ ids });
+        snapshot::write(out, std::span<const GroupMask>{ groups });
+
+        for (const GroupMembers& members : groupMembers_)
+        {
+            snapshot::write(out, static_cast<std::uint64_t>(members.count_));
+            snapshot::write(out, std::span<const std::uint32_t>{ members.slots_.data(), members.count_ });
+        }
+    }
+
+    template <std::size_t CAPACITY, ComponentConcept... Components>
+    std::vector<PooledEntityBody<CAPACITY, Components...>> EntitiesPool<CAPACITY, Components...>::load(std::istream& in) noexcept(false)
+    {
+        if (highWater_.load(std::memory_order_relaxed) != 0U)
+        {
+            throw snapshot_exception{ "snapshot: only a freshly constructed pool may be loaded." };
+        }
+
+        const std::uint64_t highWater{ snapshot::read<std::uint64_t>(in) };
+        const std::uint64_t size{ snapshot::read<std::uint64_t>(in) };
+        if (highWater > CAPACITY || size > highWater)
+        {
+            throw snapshot_exception{ "snapshot: the entities pool's counts exceed its capacity." };
+        }
+        snapshot::read(in, std::span<std::uint32_t>{ generations_.data(), highWater });
+        snapshot::read_occupancy(in, occupancy_, highWater, size);
+
+        // reads a list of free slots, making sure each one is below highWater, not live and not listed before
+        std::vector<bool> listed(highWater);
+        std::size_t freeCount{ 0U };
+        const auto readSlots{ [&](std::size_t maxCount)
+            {
+                const std::uint64_t count{ snapshot::read<std::uint64_t>(in) };
+                if (count > maxCount)
+                {
+                    throw snapshot_exception{ "snapshot: too many free entity slots." };
+                }
+                std::vector<std::uint32_t> slots(count);
+                snapshot::read(in, std::span<std::uint32_t>{ slots });
+                for (const std::uint32_t slot : slots)
+                {
+                    if (slot >= highWater || occupancy_.test(slot) || listed[slot])
+                    {
+                        throw snapshot_exception{ "snapshot: a free entity slot is out of range, live or repeated." };
+                    }
+                    listed[slot] = true;
+                }
+                freeCount += slots.size();
+                return slots;
+            } };
+
+        const std::vector<std::uint32_t> stacked{ readSlots(highWater - size) };
+        std::ranges::copy(stacked, stack_.begin() + (CAPACITY - stacked.size()));
+
+        snapshot::expect(in, static_cast<std::uint64_t>(magazinesCount_s), "snapshot: saved with another number of magazines.");
+        for (Magazine& magazine : magazines_)
+        {
+            const std::vector<std::uint32_t> cached{ readSlots(magazine.slots_.size()) };
+            std::ranges::copy(cached, magazine.slots_.begin());
+            magazine.count_ = cached.size();
+        }
+
+        if (freeCount != highWater - size)
+        {
+            throw snapshot_exception{ "snapshot: the entities pool's free slots don't add up." };
+        }
+
+        for (std::size_t slot{ 0U }; slot != highWater; ++slot)
+        {
+            new (poolStart_ + slot) EntityBody<CAPACITY, Components...>{};
+        }
+        // from here on the destructor destroys them
+        highWater_.store(highWater, std::memory_order_release);
+        stackTop_ = CAPACITY - stacked.size();
+
+        std::vector<std::uint64_t> ids(size);
+        std::vector<GroupMask> groups(size);
+        snapshot::read(in, std::span<std::uint64_t>{ ids });
+        snapshot::read(in, std::span<GroupMask>{ groups });
+
+        std::array<std::size_t, groupsCount> membersCounts{};
+        std::size_t liveIdx{ 0U };
+        for (const std::size_t slot : occupancy_)
+        {
+            poolStart_[slot].id_ = static_cast<EntityId>(ids[liveIdx]);
+            poolStart_[slot].groups_ = groups[liveIdx];
+            for (GroupMask bits{ groups[liveIdx] }; bits != 0U; bits &= bits - 1U)
+            {
+                const std::size_t groupIdx{ static_cast<std::size_t>(std::countr_zero(bits)) };
+                if (groupIdx >= groupsCount)
+                {
+                    throw snapshot_exception{ "snapshot: an entity is a member of an unknown group." };
+                }
+                ++membersCounts[groupIdx];
+            }
+            ++liveIdx;
+        }
+
+        for (std::size_t groupIdx{ 0U }; groupIdx != groupsCount; ++groupIdx)
+        {
+            GroupMembers& members{ groupMembers_[groupIdx] };
+            if (snapshot::read<std::uint64_t>(in) != membersCounts[groupIdx])
+            {
+                throw snapshot_exception{ "snapshot: a group's member list doesn't match its members." };
+            }
+            snapshot::read(in, std::span<std::uint32_t>{ members.slots_.data(), membersCounts[groupIdx] });
+            members.count_ = membersCounts[groupIdx];
+
+            for (std::size_t position{ 0U }; position != members.count_; ++position)
+            {
+                const std::uint32_t slot{ members.slots_[position] };
+                if (slot >= highWater || !occupancy_.test(slot) || (poolStart_[slot].groups_ & (GroupMask{ 1U } << groupIdx)) == 0U)
+                {
+                    throw snapshot_exception{ "snapshot: a group's member list doesn't match its members." };
+                }
+                members.positions_[slot] = static_cast<std::uint32_t>(position);
+            }
+
+            // a member listed twice leaves its first position behind, and another member unlisted
+            for (std::size_t position{ 0U }; position != members.count_; ++position)
+            {
+                if (members.positions_[members.slots_[position]] != position)
+                {
+                    throw snapshot_exception{ "snapshot: a group's member list doesn't match its members." };
+                }
+            }
+        }
+
+        size_.store(size, std::memory_order_relaxed);
+
+        std::vector<PooledEntityBody<CAPACITY, Components...>> entBodies{};
+        entBodies.reserve(size);
+        for (const std::size_t slot : occupancy_)
+        {
+            entBodies.emplace_back(poolStart_ + slot, entDeleter_);
+        }
+
+        return entBodies;
+    }
 }
 
 
@@ -0,0 +1,202 @@
+#ifndef OCCUPANCY_BITSET
+#define OCCUPANCY_BITSET
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <ranges>
+#include <span>
+
+namespace ecs
+{
+    // One bit per pool slot, set while the slot is handed out.
+    // Bits are set and cleared atomically, so request and release stay lock-free.
+    // Iterating yields the indices of the set bits in ascending order, 
+    // a whole word of 64 free slots is skipped with a single comparison.
+    template <std::size_t CAPACITY>
+    class OccupancyBitset
+    {
+    public:
+        static constexpr std::size_t bitsPerWord{ 64U };
+        static constexpr std::size_t wordsCount{ (CAPACITY + bitsPerWord - 1U) / bitsPerWord };
+
+        class Iterator
+        {
+        public:
+            using value_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+
+            Iterator() noexcept = default;
+
+            Iterator(const OccupancyBitset* bitset, std::size_t wordIdx, std::size_t endWordIdx) noexcept;
+
+            [[nodiscard]] std::size_t operator*() const noexcept;
+
+            Iterator& operator++() noexcept;
+
+            Iterator operator++(int) noexcept;
+
+            [[nodiscard]] bool operator==(const Iterator& other) const noexcept = default;
+
+            [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept;
+
+        private:
+            const OccupancyBitset* bitset_{ nullptr };
+            std::size_t wordIdx_{ wordsCount };
+            std::size_t endWordIdx_{ wordsCount };
+            std::uint64_t bits_{ 0U };
+
+            void skipEmptyWords() noexcept;
+        };
+
+        OccupancyBitset() noexcept;
+
+        void set(std::size_t idx) noexcept;
+
+        void reset(std::size_t idx) noexcept;
+
+        [[nodiscard]] bool test(std::size_t idx) const noexcept;
+
+        // overwrites a whole word at once, e.g. when a pool is restored from a snapshot
+        void assign(std::size_t wordIdx, std::uint64_t bits) noexcept;
+
+        [[nodiscard]] std::uint64_t word(std::size_t wordIdx) const noexcept;
+
+        // bit i of word w stands for slot w * bitsPerWord + i
+        [[nodiscard]] std::span<const std::atomic<std::uint64_t>, wordsCount> words() const noexcept;
+
+        [[nodiscard]] Iterator begin() const noexcept;
+
+        [[nodiscard]] std::default_sentinel_t end() const noexcept;
+
+        // the set bits of words [firstWordIdx, endWordIdx) only
+        [[nodiscard]] std::ranges::subrange<Iterator, std::default_sentinel_t> slotsIn(std::size_t firstWordIdx, std::size_t endWordIdx) const noexcept;
+
+    private:
+        std::array<std::atomic<std::uint64_t>, wordsCount> words_;
+    };
+
+
+    //////// OccupancyBitset definitions //////// 
+    template <std::size_t CAPACITY>
+    OccupancyBitset<CAPACITY>::OccupancyBitset() noexcept
+        : words_{}
+    {
+        for (std::atomic<std::uint64_t>& word : words_)
+        {
+            word.store(0U, std::memory_order_relaxed);
+        }
+    }
+
+    template <std::size_t CAPACITY>
+    void OccupancyBitset<CAPACITY>::set(std::size_t idx) noexcept
+    {
+        words_[idx / bitsPerWord].fetch_or(std::uint64_t{ 1U } << (idx % bitsPerWord), std::memory_order_release);
+    }
+
+    template <std::size_t CAPACITY>
+    void OccupancyBitset<CAPACITY>::reset(std::size_t idx) noexcept
+    {
+        words_[idx / bitsPerWord].fetch_and(~(std::uint64_t{ 1U } << (idx % bitsPerWord)), std::memory_order_release);
+    }
+
+    template <std::size_t CAPACITY>
+    bool OccupancyBitset<CAPACITY>::test(std::size_t idx) const noexcept
+    {
+        return (word(idx / bitsPerWord) >> (idx % bitsPerWord)) & 1U;
+    }
+
+    template <std::size_t CAPACITY>
+    void OccupancyBitset<CAPACITY>::assign(std::size_t wordIdx, std::uint64_t bits) noexcept
+    {
+        words_[wordIdx].store(bits, std::memory_order_release);
+    }
+
+    template <std::size_t CAPACITY>
+    std::uint64_t OccupancyBitset<CAPACITY>::word(std::size_t wordIdx) const noexcept
+    {
+        return words_[wordIdx].load(std::memory_order_acquire);
+    }
+
+    template <std::size_t CAPACITY>
+    std::span<const std::atomic<std::uint64_t>, OccupancyBitset<CAPACITY>::wordsCount> OccupancyBitset<CAPACITY>::words() const noexcept
+    {
+        return words_;
+    }
+
+    template <std::size_t CAPACITY>
+    OccupancyBitset<CAPACITY>::Iterator OccupancyBitset<CAPACITY>::begin() const noexcept
+    {
+        return Iterator{ this, 0U, wordsCount };
+    }
+
+    template <std::size_t CAPACITY>
+    std::default_sentinel_t OccupancyBitset<CAPACITY>::end() const noexcept
+    {
+        return std::default_sentinel;
+    }
+
+    template <std::size_t CAPACITY>
+    std::ranges::subrange<typename OccupancyBitset<CAPACITY>::Iterator, std::default_sentinel_t> 
+        OccupancyBitset<CAPACITY>::slotsIn(std::size_t firstWordIdx, std::size_t endWordIdx) const noexcept
+    {
+        return { Iterator{ this, firstWordIdx, endWordIdx }, std::default_sentinel };
+    }
+
+    //////// Iterator definitions //////// 
+    template <std::size_t CAPACITY>
+    OccupancyBitset<CAPACITY>::Iterator::Iterator(const OccupancyBitset* bitset, std::size_t wordIdx, std::size_t endWordIdx) noexcept
+        : bitset_{ bitset }
+        , wordIdx_{ wordIdx }
+        , endWordIdx_{ endWordIdx }
+        , bits_{ wordIdx < endWordIdx ? bitset->word(wordIdx) : 0U }
+    {
+        skipEmptyWords();
+    }
+
+    template <std::size_t CAPACITY>
+    std::size_t OccupancyBitset<CAPACITY>::Iterator::operator*() const noexcept
+    {
+        return wordIdx_ * bitsPerWord + static_cast<std::size_t>(std::countr_zero(bits_));
+    }
+
+    template <std::size_t CAPACITY>
+    OccupancyBitset<CAPACITY>::Iterator& OccupancyBitset<CAPACITY>::Iterator::operator++() noexcept
+    {
+        // clear the lowest set bit
+        bits_ &= bits_ - 1U;
+        skipEmptyWords();
+        return *this;
+    }
+
+    template <std::size_t CAPACITY>
+    OccupancyBitset<CAPACITY>::Iterator OccupancyBitset<CAPACITY>::Iterator::operator++(int) noexcept
+    {
+        Iterator prev{ *this };
+        ++*this;
+        return prev;
+    }
+
+    template <std::size_t CAPACITY>
+    bool OccupancyBitset<CAPACITY>::Iterator::operator==(std::default_sentinel_t) const noexcept
+    {
+        return wordIdx_ == endWordIdx_;
+    }
+
+    template <std::size_t CAPACITY>
+    void OccupancyBitset<CAPACITY>::Iterator::skipEmptyWords() noexcept
+    {
+        while (bits_ == 0U && wordIdx_ != endWordIdx_)
+        {
+            ++wordIdx_;
+            if (wordIdx_ != endWordIdx_)
+            {
+                bits_ = bitset_->word(wordIdx_);
+            }
+        }
+    }
+}
+
+#endif // !OCCUPANCY_BITSET
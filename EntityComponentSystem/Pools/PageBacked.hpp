@@ -0,0 +1,205 @@
+#ifndef PAGE_BACKED
+#define PAGE_BACKED
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ECS_MMAP 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ecs
+{
+	// Where make_page_backed places an object.
+	// Pools and managers keep all their slots inline, so placing the object places all of its storage,
+	// e.g. an EntitiesManager<1'000'000U, ...> is far too large for the stack.
+	// The policy is deliberately chosen for the whole owner rather than given to each pool as an allocator:
+	// inline slots sit at a fixed offset from their pool, so requesting, releasing and iterating them never
+	// chases a pointer, and a manager's pools end up in one mapping, so a single madvise covers all of them.
+	// Slots are only written once handed out, so even a mapping of huge pages only becomes resident where it's used.
+	// NOTE: an ArchetypeStorage allocates its chunks on the free store, only its id bookkeeping is placed
+	enum class PagePolicy
+	{
+		// the free store
+		heap,
+		// an anonymous mapping of its own, page aligned and handed back to the OS on destruction
+		mmap,
+		// an anonymous mapping backed by huge pages, so iterating millions of slots takes far fewer TLB entries.
+		// Explicit huge pages (MAP_HUGETLB) are tried first, then transparent ones (madvise(MADV_HUGEPAGE)),
+		// where neither exists it's the same as mmap
+		hugePages
+	};
+
+	template <typename T>
+	class PageDeleter
+	{
+	public:
+		PageDeleter() noexcept = default;
+
+		PageDeleter(PagePolicy policy, std::size_t mappedBytes) noexcept;
+
+		void operator()(T* obj) const noexcept;
+
+		// the policy the object actually got, hugePages may have fallen back to mmap, and mmap to heap
+		[[nodiscard]] PagePolicy policy() const noexcept;
+
+	private:
+		PagePolicy policy_{ PagePolicy::heap };
+		std::size_t mappedBytes_{ 0U };
+	};
+
+	template <typename T>
+	using PageBacked = std::unique_ptr<T, PageDeleter<T>>;
+
+	namespace page_backed_detail
+	{
+		// 2 MiB, the huge page size on x86-64 and the usual one on AArch64
+		inline constexpr std::size_t hugePageBytes{ std::size_t{ 1U } << 21U };
+
+		[[nodiscard]] inline std::size_t round_up(std::size_t bytes, std::size_t granularity) noexcept
+		{
+			return (bytes + granularity - 1U) / granularity * granularity;
+		}
+
+#if defined(ECS_MMAP)
+		// nullptr on failure
+		[[nodiscard]] inline void* map(std::size_t bytes, int extraFlags) noexcept
+		{
+			void* region{ ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | extraFlags, -1, 0) };
+			return region == MAP_FAILED ? nullptr : region;
+		}
+
+		// transparent huge pages only back huge page aligned ranges,
+		// so map one alignment more than needed and unmap the misaligned head and the tail
+		[[nodiscard]] inline void* map_aligned(std::size_t bytes, std::size_t alignment) noexcept
+		{
+			char* const raw{ static_cast<char*>(map(bytes + alignment, 0)) };
+			if (raw == nullptr)
+			{
+				return nullptr;
+			}
+
+			char* const aligned{ raw + (alignment - reinterpret_cast<std::uintptr_t>(raw) % alignment) % alignment };
+			if (aligned != raw)
+			{
+				::munmap(raw, static_cast<std::size_t>(aligned - raw));
+			}
+			if (aligned + bytes != raw + bytes + alignment)
+			{
+				::munmap(aligned + bytes, static_cast<std::size_t>(raw + bytes + alignment - (aligned + bytes)));
+			}
+			return aligned;
+		}
+#endif
+
+		// sets policy and mappedBytes to what was actually obtained, throws std::bad_alloc if nothing was
+		template <typename T>
+		[[nodiscard]] void* allocate(PagePolicy& policy, std::size_t& mappedBytes) noexcept(false)
+		{
+#if defined(ECS_MMAP)
+			const std::size_t pageBytes{ static_cast<std::size_t>(::sysconf(_SC_PAGESIZE)) };
+
+			if (policy == PagePolicy::hugePages)
+			{
+				// whole huge pages, so the kernel can back all of it with them
+				mappedBytes = round_up(sizeof(T), hugePageBytes);
+#if defined(MAP_HUGETLB)
+				if (void* region{ map(mappedBytes, MAP_HUGETLB) })
+				{
+					return region;
+				}
+#endif
+				if (void* region{ map_aligned(mappedBytes, hugePageBytes) })
+				{
+#if defined(MADV_HUGEPAGE)
+					if (::madvise(region, mappedBytes, MADV_HUGEPAGE) == 0)
+					{
+						return region;
+					}
+#endif
+					policy = PagePolicy::mmap;
+					return region;
+				}
+				policy = PagePolicy::mmap;
+			}
+
+			if (policy == PagePolicy::mmap)
+			{
+				mappedBytes = round_up(sizeof(T), pageBytes);
+				if (alignof(T) <= pageBytes)
+				{
+					if (void* region{ map(mappedBytes, 0) })
+					{
+						return region;
+					}
+				}
+				policy = PagePolicy::heap;
+			}
+#else
+			policy = PagePolicy::heap;
+#endif
+			mappedBytes = 0U;
+			return ::operator new(sizeof(T), std::align_val_t{ alignof(T) });
+		}
+
+		inline void deallocate(void* region, PagePolicy policy, std::size_t mappedBytes, std::size_t alignment) noexcept
+		{
+#if defined(ECS_MMAP)
+			if (policy != PagePolicy::heap)
+			{
+				::munmap(region, mappedBytes);
+				return;
+			}
+#endif
+			static_cast<void>(mappedBytes);
+			::operator delete(region, std::align_val_t{ alignment });
+		}
+	}
+
+	// constructs a T from args in storage chosen by policy, e.g.
+	// auto entitiesManager{ ecs::make_page_backed<ecs::EntitiesManager<1'000'000U, ecs::PhysicsComponent>>(ecs::PagePolicy::hugePages) };
+	// throws std::bad_alloc if no storage could be obtained at all
+	template <typename T, typename... Args>
+	[[nodiscard]] PageBacked<T> make_page_backed(PagePolicy policy, Args&&... args) noexcept(false)
+	{
+		std::size_t mappedBytes{ 0U };
+		void* region{ page_backed_detail::allocate<T>(policy, mappedBytes) };
+
+		try
+		{
+			return PageBacked<T>{ new (region) T(std::forward<Args>(args)...), PageDeleter<T>{ policy, mappedBytes } };
+		}
+		catch (...)
+		{
+			page_backed_detail::deallocate(region, policy, mappedBytes, alignof(T));
+			throw;
+		}
+	}
+
+
+	template <typename T>
+	PageDeleter<T>::PageDeleter(PagePolicy policy, std::size_t mappedBytes) noexcept
+		: policy_{ policy }
+		, mappedBytes_{ mappedBytes }
+	{ }
+
+	template <typename T>
+	void PageDeleter<T>::operator()(T* obj) const noexcept
+	{
+		obj->~T();
+		page_backed_detail::deallocate(obj, policy_, mappedBytes_, alignof(T));
+	}
+
+	template <typename T>
+	PagePolicy PageDeleter<T>::policy() const noexcept
+	{
+		return policy_;
+	}
+}
+
+#endif // !PAGE_BACKED
@@ -0,0 +1,158 @@
+#ifndef SNAPSHOT
+#define SNAPSHOT
+
+#include "OccupancyBitset.hpp"
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ecs
+{
+    // thrown when a snapshot can't be written, or can't be loaded: it's truncated,
+    // of another format version, or was saved by a manager of another CAPACITY or Components
+    class snapshot_exception : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+
+    // The binary format written by EntitiesManager::save and read by EntitiesManager::load.
+    // Components are trivially copyable, so a run of live slots is written as the raw bytes of its storage,
+    // and loading it back is a single read straight into the pool.
+    // Values are written in the native byte order, the header records it so a foreign snapshot is refused.
+    namespace snapshot
+    {
+        inline constexpr std::array<char, 8U> magic{ 'E', 'C', 'S', 'S', 'N', 'A', 'P', '\0' };
+
+        // bumped whenever the layout of a snapshot changes
+        inline constexpr std::uint32_t version{ 1U };
+
+        // reads back as another value on a machine of the other byte order
+        inline constexpr std::uint32_t byteOrderMark{ 0x0102'0304U };
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void write(std::ostream& out, std::span<const T> values) noexcept(false)
+        {
+            out.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+            if (!out) [[unlikely]]
+            {
+                throw snapshot_exception{ "snapshot: writing failed." };
+            }
+        }
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void write(std::ostream& out, const T& value) noexcept(false)
+        {
+            write(out, std::span<const T>{ &value, 1U });
+        }
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void read(std::istream& in, std::span<T> values) noexcept(false)
+        {
+            in.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+            if (!in) [[unlikely]]
+            {
+                throw snapshot_exception{ "snapshot: truncated." };
+            }
+        }
+
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        [[nodiscard]] T read(std::istream& in) noexcept(false)
+        {
+            T value{};
+            read(in, std::span<T>{ &value, 1U });
+            return value;
+        }
+
+        // reads a value written by write(out, expected), throws with message unless it's the expected one
+        template <typename T>
+            requires std::is_trivially_copyable_v<T>
+        void expect(std::istream& in, const T& expected, const char* message) noexcept(false)
+        {
+            if (read<T>(in) != expected)
+            {
+                throw snapshot_exception{ message };
+            }
+        }
+
+        // calls f(first, count) for every run of consecutive set bits, in ascending order
+        template <std::size_t CAPACITY, typename F>
+        void for_each_run(const OccupancyBitset<CAPACITY>& occupancy, F&& f)
+        {
+            std::size_t first{ 0U };
+            std::size_t count{ 0U };
+            for (const std::size_t slot : occupancy)
+            {
+                if (count != 0U && slot == first + count)
+                {
+                    ++count;
+                    continue;
+                }
+
+                if (count != 0U)
+                {
+                    f(first, count);
+                }
+                first = slot;
+                count = 1U;
+            }
+
+            if (count != 0U)
+            {
+                f(first, count);
+            }
+        }
+
+        // writes the words of occupancy holding slots [0, slotsCount)
+        template <std::size_t CAPACITY>
+        void write_occupancy(std::ostream& out, const OccupancyBitset<CAPACITY>& occupancy, std::size_t slotsCount) noexcept(false)
+        {
+            const std::size_t wordsCount{ (slotsCount + OccupancyBitset<CAPACITY>::bitsPerWord - 1U) / OccupancyBitset<CAPACITY>::bitsPerWord };
+            for (std::size_t wordIdx{ 0U }; wordIdx != wordsCount; ++wordIdx)
+            {
+                write(out, occupancy.word(wordIdx));
+            }
+        }
+
+        // reads what write_occupancy wrote into a cleared bitset,
+        // throws unless exactly liveCount slots are set, all of them below slotsCount
+        template <std::size_t CAPACITY>
+        void read_occupancy(std::istream& in, OccupancyBitset<CAPACITY>& occupancy, std::size_t slotsCount, std::size_t liveCount) noexcept(false)
+        {
+            constexpr std::size_t bitsPerWord{ OccupancyBitset<CAPACITY>::bitsPerWord };
+
+            std::size_t setCount{ 0U };
+            for (std::size_t wordIdx{ 0U }; wordIdx * bitsPerWord < slotsCount; ++wordIdx)
+            {
+                const std::uint64_t bits{ read<std::uint64_t>(in) };
+                const std::size_t slotsInWord{ slotsCount - wordIdx * bitsPerWord };
+                if (slotsInWord < bitsPerWord && (bits >> slotsInWord) != 0U)
+                {
+                    throw snapshot_exception{ "snapshot: a live slot lies past the slots ever handed out." };
+                }
+
+                setCount += static_cast<std::size_t>(std::popcount(bits));
+                occupancy.assign(wordIdx, bits);
+            }
+
+            if (setCount != liveCount)
+            {
+                throw snapshot_exception{ "snapshot: the live slots don't match the pool's size." };
+            }
+        }
+    }
+}
+
+#endif // !SNAPSHOT
@@ -2,23 +2,78 @@
 #define DECREASE_LIFETIME_SYSTEM
 
 #include "EntitiesManager.hpp"
+#include "LifetimeComponent.hpp"
+#include "ParallelFor.hpp"
+#include "CommandBuffer.hpp"
+#include "Instrumentation.hpp"
 
 namespace ecs
 {
-	template <std::size_t CAPACITY>
-	void decrease_lifetime_system(EntitiesManager<CAPACITY>& entitiesManager)
+	inline void decrease_lifetime(LifetimeComponent& lifetimeComp)
 	{
-		for (LifetimeComponent& lifetimeComp : entitiesManager.lifetimeComponentsPool_)
+		--lifetimeComp.lifetime;
+		if (lifetimeComp.lifetime == 0U)
 		{
-			if (lifetimeComp.valid)
+			// do something
+		}
+	}
+
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void decrease_lifetime_system(EntitiesManager<CAPACITY, Components...>& entitiesManager)
+	{
+		instrumentation::SystemScope scope{ "decrease_lifetime_system" };
+		scope.processed(entitiesManager.template componentPool<LifetimeComponent>().size());
+
+		for (LifetimeComponent& lifetimeComp : entitiesManager.template componentPool<LifetimeComponent>().live())
+		{
+			decrease_lifetime(lifetimeComp);
+		}
+	}
+
+	// same as above, and every entity whose lifetime runs out is destroyed on commands' next playback
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void decrease_lifetime_system(EntitiesManager<CAPACITY, Components...>& entitiesManager, CommandBuffer<CAPACITY, Components...>& commands)
+	{
+		instrumentation::SystemScope scope{ "decrease_lifetime_system" };
+		scope.processed(entitiesManager.template componentPool<LifetimeComponent>().size());
+
+		for (auto [owner, lifetimeComp] : entitiesManager.template owned<LifetimeComponent>())
+		{
+			decrease_lifetime(lifetimeComp);
+			if (lifetimeComp.lifetime == 0U)
 			{
-				--lifetimeComp.lifetime;
+				commands.destroy(owner);
+			}
+		}
+	}
+
+	// same as decrease_lifetime_system with the slots split into chunks which run concurrently on threadPool
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void parallel_decrease_lifetime_system(EntitiesManager<CAPACITY, Components...>& entitiesManager, ThreadPool& threadPool)
+	{
+		instrumentation::SystemScope scope{ "parallel_decrease_lifetime_system" };
+		scope.processed(entitiesManager.template componentPool<LifetimeComponent>().size());
+
+		parallel_for_each(threadPool, entitiesManager.template componentPool<LifetimeComponent>(), decrease_lifetime);
+	}
+
+	// same as above, and every entity whose lifetime runs out is destroyed on commands' next playback
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void parallel_decrease_lifetime_system(EntitiesManager<CAPACITY, Components...>& entitiesManager, ThreadPool& threadPool,
+		CommandBuffer<CAPACITY, Components...>& commands)
+	{
+		instrumentation::SystemScope scope{ "parallel_decrease_lifetime_system" };
+		scope.processed(entitiesManager.template componentPool<LifetimeComponent>().size());
+
+		parallel_for_each(threadPool, entitiesManager.template componentPool<LifetimeComponent>(), 
+			[&entitiesManager, &commands](LifetimeComponent& lifetimeComp)
+			{
+				decrease_lifetime(lifetimeComp);
 				if (lifetimeComp.lifetime == 0U)
 				{
-					// do something
+					commands.destroy(entitiesManager.template ownerOf<LifetimeComponent>(&lifetimeComp));
 				}
-			}
-		}
+			});
 	}
 }
 
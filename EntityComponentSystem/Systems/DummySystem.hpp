@@ -2,19 +2,21 @@
 #define DUMMY_SYSTEM
 
 #include "EntitiesManager.hpp"
+#include "Instrumentation.hpp"
 
 namespace ecs
 {
-	template <std::size_t CAPACITY>
-	void dummy_system(EntitiesManager<CAPACITY>& entitiesManager)
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void dummy_system(EntitiesManager<CAPACITY, Components...>& entitiesManager)
 	{
-		for (EntityBody<CAPACITY>& entBody : entitiesManager.entitiesPool_)
+		instrumentation::SystemScope scope{ "dummy_system" };
+		scope.processed(entitiesManager.entitiesPool().membersCount(Group::dummy_group));
+
+		// only the group's members are visited, not every live entity
+		for (EntityBody<CAPACITY, Components...>& entBody : entitiesManager.entitiesPool().members(Group::dummy_group))
 		{
-			const auto grpsEnd{ std::cend(entBody.groups_) };
-			if (std::find(std::cbegin(entBody.groups_), grpsEnd, Group::dummy_group) != grpsEnd)
-			{
-				// do somthing
-			}
+			static_cast<void>(entBody);
+			// do somthing
 		}
 	}
 }
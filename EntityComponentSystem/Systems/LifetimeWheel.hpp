@@ -0,0 +1,183 @@
+#ifndef LIFETIME_WHEEL
+#define LIFETIME_WHEEL
+
+#include "EntitiesPool.hpp"
+#include "CommandBuffer.hpp"
+#include "Instrumentation.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace ecs
+{
+	// Expires entities after a given number of ticks without visiting the others on every tick,
+	// an alternative to decrementing every LifetimeComponent.
+	// A hierarchical timing wheel: level l has 256 slots of 256^l ticks each. An entity is filed on the level
+	// of the highest byte in which its expiry tick differs from the current one, and is moved down a level
+	// whenever the wheel below that one wraps around, so each tick only touches the entities expiring
+	// in it plus those due to move down (each entity moves down at most levelsCount_s - 1 times).
+	// Entities are identified by EntityHandle and indexed by its slot, hence CAPACITY.
+	// NOTE: not thread-safe, meant to be owned by a single system
+	template <std::size_t CAPACITY>
+	class LifetimeWheel
+	{
+	public:
+		LifetimeWheel() noexcept;
+
+		// the entity expires on the lifetime'th advance() from now (a lifetime of 0 counts as 1),
+		// replacing its previous schedule if any. False if the handle's slot is out of range, e.g. EntityHandle{}
+		[[nodiscard]] bool schedule(EntityHandle handle, std::uint32_t lifetime) noexcept(false);
+
+		// the entity won't expire unless scheduled again, handles out of range are ignored
+		void cancel(EntityHandle handle) noexcept;
+
+		// moves one tick forward and returns the entities expiring in it, valid until the next advance().
+		// An entity released before it expired is still returned, its handle is stale by then
+		[[nodiscard]] std::span<const EntityHandle> advance() noexcept(false);
+
+		// the number of advance() calls so far
+		[[nodiscard]] std::uint64_t now() const noexcept;
+
+	private:
+		// 5 levels of 8 bits cover any 32-bit lifetime, even when it crosses a 2^32 boundary of the current tick.
+		// Past 2^40 ticks a carry may reach higher bits still, such entries are filed on the top level, see insert()
+		static constexpr std::size_t levelsCount_s{ 5U };
+		static constexpr std::size_t slotBits_s{ 8U };
+		static constexpr std::size_t slotsCount_s{ std::size_t{ 1U } << slotBits_s };
+
+		struct Entry
+		{
+			EntityHandle handle_;
+			// must match stamps_[handle_.index_], else the entry was cancelled or rescheduled
+			std::uint32_t stamp_;
+			std::uint64_t expiry_;
+		};
+
+		std::array<std::array<std::vector<Entry>, slotsCount_s>, levelsCount_s> levels_;
+		std::array<std::uint32_t, CAPACITY> stamps_;
+		std::uint64_t now_;
+		std::vector<EntityHandle> expired_;
+		std::vector<Entry> cascading_;
+
+		void insert(const Entry& entry) noexcept(false);
+
+		[[nodiscard]] bool isCurrent(const Entry& entry) const noexcept;
+	};
+
+
+	template <std::size_t CAPACITY>
+	LifetimeWheel<CAPACITY>::LifetimeWheel() noexcept
+		: levels_{}
+		, stamps_{}
+		, now_{ 0U }
+		, expired_{}
+		, cascading_{}
+	{ }
+
+	template <std::size_t CAPACITY>
+	bool LifetimeWheel<CAPACITY>::schedule(EntityHandle handle, std::uint32_t lifetime) noexcept(false)
+	{
+		if (handle.index_ >= CAPACITY)
+		{
+			return false;
+		}
+
+		++stamps_[handle.index_];
+		insert(Entry{ handle, stamps_[handle.index_], now_ + std::max(lifetime, std::uint32_t{ 1U }) });
+		return true;
+	}
+
+	template <std::size_t CAPACITY>
+	void LifetimeWheel<CAPACITY>::cancel(EntityHandle handle) noexcept
+	{
+		if (handle.index_ < CAPACITY)
+		{
+			++stamps_[handle.index_];
+		}
+	}
+
+	template <std::size_t CAPACITY>
+	std::span<const EntityHandle> LifetimeWheel<CAPACITY>::advance() noexcept(false)
+	{
+		++now_;
+		expired_.clear();
+
+		// the levels whose lower levels all wrapped around move their current slot down, highest first,
+		// so an entry may move down several levels in a single tick
+		std::size_t wrapped{ 0U };
+		while (wrapped + 1U != levelsCount_s && (now_ & ((std::uint64_t{ 1U } << (slotBits_s * (wrapped + 1U))) - 1U)) == 0U)
+		{
+			++wrapped;
+		}
+		for (std::size_t level{ wrapped }; level != 0U; --level)
+		{
+			std::vector<Entry>& slot{ levels_[level][(now_ >> (slotBits_s * level)) & (slotsCount_s - 1U)] };
+			cascading_.swap(slot);
+			for (const Entry& entry : cascading_)
+			{
+				if (isCurrent(entry))
+				{
+					insert(entry);
+				}
+			}
+			cascading_.clear();
+		}
+
+		std::vector<Entry>& due{ levels_[0U][now_ & (slotsCount_s - 1U)] };
+		for (const Entry& entry : due)
+		{
+			if (isCurrent(entry))
+			{
+				expired_.push_back(entry.handle_);
+				++stamps_[entry.handle_.index_];
+			}
+		}
+		due.clear();
+
+		return expired_;
+	}
+
+	template <std::size_t CAPACITY>
+	std::uint64_t LifetimeWheel<CAPACITY>::now() const noexcept
+	{
+		return now_;
+	}
+
+	template <std::size_t CAPACITY>
+	void LifetimeWheel<CAPACITY>::insert(const Entry& entry) noexcept(false)
+	{
+		// an entry moved down on its expiry tick differs in no bit, and goes to the level 0 slot about to expire.
+		// A carry past bit 39 would pick a level that doesn't exist, but an expiry is less than 2^32 ticks ahead,
+		// so its top level slot is at most the next one and it's moved down again when the lower levels wrap
+		const std::size_t level{ std::min(
+			static_cast<std::size_t>(std::bit_width((entry.expiry_ ^ now_) | 1U) - 1) / slotBits_s, levelsCount_s - 1U) };
+		levels_[level][(entry.expiry_ >> (slotBits_s * level)) & (slotsCount_s - 1U)].push_back(entry);
+	}
+
+	template <std::size_t CAPACITY>
+	bool LifetimeWheel<CAPACITY>::isCurrent(const Entry& entry) const noexcept
+	{
+		return stamps_[entry.handle_.index_] == entry.stamp_;
+	}
+
+
+	// destroys the entities expiring this tick on commands' next playback
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void expire_lifetimes_system(LifetimeWheel<CAPACITY>& wheel, CommandBuffer<CAPACITY, Components...>& commands)
+	{
+		instrumentation::SystemScope scope{ "expire_lifetimes_system" };
+
+		const std::span<const EntityHandle> expired{ wheel.advance() };
+		scope.processed(expired.size());
+		for (const EntityHandle handle : expired)
+		{
+			commands.destroy(handle);
+		}
+	}
+}
+
+#endif // !LIFETIME_WHEEL
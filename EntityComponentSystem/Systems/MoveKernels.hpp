@@ -0,0 +1,187 @@
+#ifndef MOVE_KERNELS
+#define MOVE_KERNELS
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <span>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ECS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit instructions beyond the baseline in functions which ask for them,
+// MSVC emits any intrinsic regardless of /arch
+#if defined(ECS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define ECS_TARGET_SSE2 __attribute__((target("sse2")))
+#define ECS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define ECS_TARGET_SSE2
+#define ECS_TARGET_AVX2
+#endif
+
+namespace ecs
+{
+	enum class SimdLevel
+	{
+		scalar,
+		sse2,
+		avx2
+	};
+
+	[[nodiscard]] inline SimdLevel detect_simd_level() noexcept
+	{
+#if defined(ECS_X86) && (defined(__GNUC__) || defined(__clang__))
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return SimdLevel::avx2;
+		}
+		return __builtin_cpu_supports("sse2") ? SimdLevel::sse2 : SimdLevel::scalar;
+#elif defined(ECS_X86) && defined(_MSC_VER)
+		int regs[4]{};
+		__cpuid(regs, 1);
+		const bool sse2{ (regs[3] & (1 << 26)) != 0 };
+		const bool osxsave{ (regs[2] & (1 << 27)) != 0 };
+
+		// the OS must also save the upper halves of the ymm registers
+		if (osxsave && (_xgetbv(0) & 0x6U) == 0x6U)
+		{
+			__cpuidex(regs, 7, 0);
+			if ((regs[1] & (1 << 5)) != 0)
+			{
+				return SimdLevel::avx2;
+			}
+		}
+		return sse2 ? SimdLevel::sse2 : SimdLevel::scalar;
+#else
+		return SimdLevel::scalar;
+#endif
+	}
+
+	struct MoveColumns
+	{
+		float* xPos;
+		float* yPos;
+		const float* xVelocity;
+		const float* yVelocity;
+	};
+
+	// Kernels apply "pos += velocity" to the live slots only,
+	// liveness is taken from occupancy words (bit i of word w stands for slot w * 64 + i).
+	// Dead slots are never written, and memory past the last live slot is never read.
+	using MoveKernel = void (*)(const MoveColumns& columns, std::span<const std::atomic<std::uint64_t>> occupancy);
+
+	namespace move_kernels
+	{
+		// words with fewer live slots than this are cheaper to walk bit by bit than with masked vectors,
+		// e.g. at 5% occupancy a word holds ~3 live slots
+		inline constexpr int sparseWordThreshold{ 8 };
+
+		inline void scalar_bits(const MoveColumns& columns, std::size_t base, std::uint64_t bits) noexcept
+		{
+			for (; bits != 0U; bits &= bits - 1U)
+			{
+				const std::size_t slot{ base + static_cast<std::size_t>(std::countr_zero(bits)) };
+				columns.xPos[slot] += columns.xVelocity[slot];
+				columns.yPos[slot] += columns.yVelocity[slot];
+			}
+		}
+
+		inline void scalar(const MoveColumns& columns, std::span<const std::atomic<std::uint64_t>> occupancy)
+		{
+			for (std::size_t w{ 0U }; w != occupancy.size(); ++w)
+			{
+				scalar_bits(columns, w * 64U, occupancy[w].load(std::memory_order_acquire));
+			}
+		}
+
+#if defined(ECS_X86)
+		// 4 slots per instruction. SSE2 has no masked stores, 
+		// so only fully live words are vectorized and the rest are walked bit by bit
+		ECS_TARGET_SSE2 inline void sse2(const MoveColumns& columns, std::span<const std::atomic<std::uint64_t>> occupancy)
+		{
+			for (std::size_t w{ 0U }; w != occupancy.size(); ++w)
+			{
+				const std::uint64_t word{ occupancy[w].load(std::memory_order_acquire) };
+				if (word != ~std::uint64_t{ 0U })
+				{
+					scalar_bits(columns, w * 64U, word);
+					continue;
+				}
+
+				for (std::size_t base{ w * 64U }; base != (w + 1U) * 64U; base += 4U)
+				{
+					_mm_storeu_ps(columns.xPos + base, _mm_add_ps(_mm_loadu_ps(columns.xPos + base), _mm_loadu_ps(columns.xVelocity + base)));
+					_mm_storeu_ps(columns.yPos + base, _mm_add_ps(_mm_loadu_ps(columns.yPos + base), _mm_loadu_ps(columns.yVelocity + base)));
+				}
+			}
+		}
+
+		// 8 slots per instruction, partially live groups are handled with masked loads and stores
+		ECS_TARGET_AVX2 inline void avx2(const MoveColumns& columns, std::span<const std::atomic<std::uint64_t>> occupancy)
+		{
+			const __m256i laneBits{ _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128) };
+
+			for (std::size_t w{ 0U }; w != occupancy.size(); ++w)
+			{
+				const std::uint64_t word{ occupancy[w].load(std::memory_order_acquire) };
+				if (std::popcount(word) < sparseWordThreshold)
+				{
+					scalar_bits(columns, w * 64U, word);
+					continue;
+				}
+
+				for (std::size_t group{ 0U }; group != 8U; ++group)
+				{
+					const std::uint64_t bits{ (word >> (group * 8U)) & 0xFFU };
+					const std::size_t base{ w * 64U + group * 8U };
+					if (bits == 0xFFU)
+					{
+						_mm256_storeu_ps(columns.xPos + base, _mm256_add_ps(_mm256_loadu_ps(columns.xPos + base), _mm256_loadu_ps(columns.xVelocity + base)));
+						_mm256_storeu_ps(columns.yPos + base, _mm256_add_ps(_mm256_loadu_ps(columns.yPos + base), _mm256_loadu_ps(columns.yVelocity + base)));
+					}
+					else if (bits != 0U)
+					{
+						// lane i is all ones iff bit i is set
+						const __m256i mask{ _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), laneBits), laneBits) };
+
+						_mm256_maskstore_ps(columns.xPos + base, mask, _mm256_add_ps(
+							_mm256_maskload_ps(columns.xPos + base, mask), _mm256_maskload_ps(columns.xVelocity + base, mask)));
+						_mm256_maskstore_ps(columns.yPos + base, mask, _mm256_add_ps(
+							_mm256_maskload_ps(columns.yPos + base, mask), _mm256_maskload_ps(columns.yVelocity + base, mask)));
+					}
+				}
+			}
+		}
+#endif // ECS_X86
+
+		[[nodiscard]] inline MoveKernel for_level(SimdLevel level) noexcept
+		{
+			switch (level)
+			{
+#if defined(ECS_X86)
+			case SimdLevel::avx2:
+				return avx2;
+			case SimdLevel::sse2:
+				return sse2;
+#endif
+			default:
+				return scalar;
+			}
+		}
+	}
+
+	// the kernel for the best instruction set the CPU supports, detected once
+	[[nodiscard]] inline MoveKernel dispatched_move_kernel() noexcept
+	{
+		static const MoveKernel kernel{ move_kernels::for_level(detect_simd_level()) };
+		return kernel;
+	}
+}
+
+#endif // !MOVE_KERNELS
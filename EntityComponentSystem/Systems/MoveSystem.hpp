@@ -2,20 +2,55 @@
 #define MOVE_SYSTEM
 
 #include "EntitiesManager.hpp"
+#include "PhysicsComponent.hpp"
+#include "MoveKernels.hpp"
+#include "ParallelFor.hpp"
+#include "Instrumentation.hpp"
 
 namespace ecs
 {
-	template <std::size_t CAPACITY>
-	void move_system(EntitiesManager<CAPACITY>& entitiesManager)
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void move_system(EntitiesManager<CAPACITY, Components...>& entitiesManager)
 	{
-		for (PhysicsComponent& physComp : entitiesManager.physicsComponentsPool_)
-		{
-			if (physComp.valid)
+		// PhysicsComponent is stored as structure-of-arrays, 
+		// so only the four touched columns are streamed through the cache
+		auto& physicsPool{ entitiesManager.template componentPool<PhysicsComponent>() };
+		instrumentation::SystemScope scope{ "move_system" };
+		scope.processed(physicsPool.size());
+		const MoveColumns columns{
+			physicsPool.template column<&PhysicsComponent::xPos>().data(),
+			physicsPool.template column<&PhysicsComponent::yPos>().data(),
+			physicsPool.template column<&PhysicsComponent::xVelocity>().data(),
+			physicsPool.template column<&PhysicsComponent::yVelocity>().data() };
+
+		dispatched_move_kernel()(columns, physicsPool.occupancy().words());
+	}
+
+	// same as move_system with the slots split into chunks which run concurrently on threadPool
+	template <std::size_t CAPACITY, ComponentConcept... Components>
+	void parallel_move_system(EntitiesManager<CAPACITY, Components...>& entitiesManager, ThreadPool& threadPool)
+	{
+		auto& physicsPool{ entitiesManager.template componentPool<PhysicsComponent>() };
+		instrumentation::SystemScope scope{ "parallel_move_system" };
+		scope.processed(physicsPool.size());
+		const MoveColumns columns{
+			physicsPool.template column<&PhysicsComponent::xPos>().data(),
+			physicsPool.template column<&PhysicsComponent::yPos>().data(),
+			physicsPool.template column<&PhysicsComponent::xVelocity>().data(),
+			physicsPool.template column<&PhysicsComponent::yVelocity>().data() };
+		const auto words{ physicsPool.occupancy().words() };
+		const MoveKernel kernel{ dispatched_move_kernel() };
+
+		parallel_for_chunks(threadPool, CAPACITY, defaultChunkSlots, [&columns, words, kernel](SlotChunk chunk)
 			{
-				physComp.xPos += physComp.xVelocity;
-				physComp.yPos += physComp.yVelocity;
-			}
-		}
+				// chunks start on a word boundary, so the kernel sees the chunk as a pool of its own
+				const MoveColumns chunkColumns{
+					columns.xPos + chunk.begin,
+					columns.yPos + chunk.begin,
+					columns.xVelocity + chunk.begin,
+					columns.yVelocity + chunk.begin };
+				kernel(chunkColumns, words.subspan(chunk.begin / 64U, (chunk.end - chunk.begin + 63U) / 64U));
+			});
 	}
 }
 
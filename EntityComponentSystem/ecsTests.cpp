@@ -1,11 +1,35 @@
+#include "PhysicsComponent.hpp"
+#include "LifetimeComponent.hpp"
 #include "MoveSystem.hpp"
 #include "DecLifetimeSystem.hpp"
 #include "DummySystem.hpp"
+#include "Scheduler.hpp"
+#include "CommandBuffer.hpp"
+#include "LifetimeWheel.hpp"
+#include "ArchetypeStorage.hpp"
+#include "PageBacked.hpp"
+#include "Instrumentation.hpp"
+#include "ChromeTrace.hpp"
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <future>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// the components the tests register
+template<std::size_t CAPACITY>
+using EntitiesManager = ecs::EntitiesManager<CAPACITY, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+
+template<std::size_t CAPACITY>
+using PooledVariant = ecs::PooledVariant<CAPACITY, ecs::PhysicsComponent, ecs::LifetimeComponent>;
 
 template<std::size_t CAPACITY>
 struct PhysicsVisitor
@@ -32,31 +56,31 @@ struct PhysicsVisitor
 
 TEST_CASE("EntitiesManager::isFull")
 {
-	ecs::EntitiesManager<2U> entitiesManager{};
+	EntitiesManager<2U> entitiesManager{};
 
 	{
-		ecs::EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
+		EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
 		REQUIRE_FALSE(entitiesManager.isFull());
 		REQUIRE(ent1.getId() == 0U);
 	}
 	
 	{
-		ecs::EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
+		EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
 		REQUIRE_FALSE(entitiesManager.isFull());
 		REQUIRE(ent1.getId() == 1U);
 
-		ecs::EntitiesManager<2U>::Entity ent2 = entitiesManager.requestEntity();
+		EntitiesManager<2U>::Entity ent2 = entitiesManager.requestEntity();
 		REQUIRE(entitiesManager.isFull());
 		REQUIRE(ent2.getId() == 2U);
 
 		REQUIRE_THROWS_AS(entitiesManager.requestEntity(), ecs::entities_max_capacity_exception);
 	}
 
-	ecs::EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
+	EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
 	REQUIRE_FALSE(entitiesManager.isFull());
 	REQUIRE(ent1.getId() == 3U);
 
-	ecs::EntitiesManager<2U>::Entity ent2 = entitiesManager.requestEntity();
+	EntitiesManager<2U>::Entity ent2 = entitiesManager.requestEntity();
 	REQUIRE(entitiesManager.isFull());
 	REQUIRE(ent2.getId() == 4U);
 
@@ -66,17 +90,17 @@ TEST_CASE("EntitiesManager::isFull")
 TEST_CASE("Entity::components")
 {
 	// hasComponent, getComponent, addComponent, removeComponent
-	ecs::EntitiesManager<2U> entitiesManager{};
+	EntitiesManager<2U> entitiesManager{};
 
-	ecs::EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
+	EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
 
 	REQUIRE_FALSE(ent1.hasComponent<ecs::PhysicsComponent>());
 	REQUIRE_FALSE(ent1.hasComponent<ecs::LifetimeComponent>());
 
-	ecs::PooledVariant<2U>& wantedPhysCompoVar = ent1.getComponent<ecs::PhysicsComponent>();
+	PooledVariant<2U>& wantedPhysCompoVar = ent1.getComponent<ecs::PhysicsComponent>();
 	REQUIRE(std::holds_alternative<std::monostate>(wantedPhysCompoVar));
 	
-	ecs::PooledVariant<2U>& wantedLifetimeCompoVar = ent1.getComponent<ecs::LifetimeComponent>();
+	PooledVariant<2U>& wantedLifetimeCompoVar = ent1.getComponent<ecs::LifetimeComponent>();
 	REQUIRE(std::holds_alternative<std::monostate>(wantedLifetimeCompoVar));
 
 	REQUIRE_FALSE(ent1.removeComponent<ecs::PhysicsComponent>());
@@ -87,13 +111,12 @@ TEST_CASE("Entity::components")
 
 	REQUIRE(ent1.hasComponent<ecs::PhysicsComponent>());
 
-	ecs::PooledVariant<2U>& physCompoVar = ent1.getComponent<ecs::PhysicsComponent>();
+	PooledVariant<2U>& physCompoVar = ent1.getComponent<ecs::PhysicsComponent>();
 	
 	REQUIRE(std::holds_alternative<ecs::PooledComponent<ecs::PhysicsComponent, 2U>>(physCompoVar));
 
 	auto& physCompo = std::get<ecs::PooledComponent<ecs::PhysicsComponent, 2U>>(physCompoVar);
 
-	REQUIRE(physCompo->valid == true);
 	REQUIRE(physCompo->xPos == 0.0f);
 	REQUIRE(physCompo->yPos == 0.0f);
 	REQUIRE(physCompo->xVelocity == 0.0f);
@@ -104,7 +127,6 @@ TEST_CASE("Entity::components")
 
 	std::visit(PhysicsVisitor<2U>{}, physCompoVar);
 
-	REQUIRE(physCompo->valid == true);
 	REQUIRE(physCompo->xPos == 5.34f);
 	REQUIRE(physCompo->yPos == 1.4f);
 	REQUIRE(physCompo->xVelocity == 2.0f);
@@ -112,16 +134,74 @@ TEST_CASE("Entity::components")
 
 	REQUIRE(ent1.removeComponent<ecs::PhysicsComponent>());
 	REQUIRE_FALSE(ent1.hasComponent<ecs::PhysicsComponent>());
-	ecs::PooledVariant<2U>& wantedPhysCompoVar2 = ent1.getComponent<ecs::PhysicsComponent>();
+	PooledVariant<2U>& wantedPhysCompoVar2 = ent1.getComponent<ecs::PhysicsComponent>();
 	REQUIRE(std::holds_alternative<std::monostate>(wantedPhysCompoVar2));
+
+	// every component type has its own slot, whatever the order components were added in
+	STATIC_REQUIRE(ecs::componentSlot<ecs::PhysicsComponent, ecs::PhysicsComponent, ecs::LifetimeComponent> == 0U);
+	STATIC_REQUIRE(ecs::componentSlot<ecs::LifetimeComponent, ecs::PhysicsComponent, ecs::LifetimeComponent> == 1U);
+	REQUIRE(ent1.addComponent<ecs::LifetimeComponent>());
+	REQUIRE(ent1.addComponent<ecs::PhysicsComponent>());
+	REQUIRE(&ent1.getComponent<ecs::PhysicsComponent>() == &wantedPhysCompoVar);
+	REQUIRE(&ent1.getComponent<ecs::LifetimeComponent>() == &wantedLifetimeCompoVar);
+	REQUIRE(std::holds_alternative<ecs::PooledComponent<ecs::LifetimeComponent, 2U>>(wantedLifetimeCompoVar));
+
+	// a full pool throws, leaving the entity without the component
+	EntitiesManager<2U>::Entity ent2 = entitiesManager.requestEntity();
+	ecs::PooledComponent<ecs::PhysicsComponent, 2U> held{ entitiesManager.componentPool<ecs::PhysicsComponent>().request() };
+	REQUIRE_THROWS_AS(ent2.addComponent<ecs::PhysicsComponent>(), ecs::components_max_capacity_exception);
+	REQUIRE_THROWS_AS(entitiesManager.addComponent<ecs::PhysicsComponent>(ent2.getHandle()), ecs::components_max_capacity_exception);
+	REQUIRE_FALSE(ent2.hasComponent<ecs::PhysicsComponent>());
+
+	held.reset();
+	REQUIRE(ent2.addComponent<ecs::PhysicsComponent>());
+}
+
+namespace
+{
+	// components the library doesn't know about
+	struct HealthComponent
+	{
+		int health;
+	};
+
+	struct TagComponent
+	{
+		char tag;
+	};
+}
+
+TEST_CASE("EntitiesManager::registered components")
+{
+	using Manager = ecs::EntitiesManager<4U, TagComponent, ecs::LifetimeComponent, HealthComponent>;
+	auto entitiesManager{ std::make_unique<Manager>() };
+
+	STATIC_REQUIRE(ecs::componentSlot<HealthComponent, TagComponent, ecs::LifetimeComponent, HealthComponent> == 2U);
+	STATIC_REQUIRE(std::variant_size_v<ecs::PooledVariant<4U, TagComponent, ecs::LifetimeComponent, HealthComponent>> == 4U);
+
+	Manager::Entity ent{ entitiesManager->requestEntity() };
+	REQUIRE(ent.addComponent<HealthComponent>());
+	REQUIRE_FALSE(ent.hasComponent<TagComponent>());
+	std::get<ecs::PooledComponent<HealthComponent, 4U>>(ent.getComponent<HealthComponent>())->health = 7;
+	REQUIRE(entitiesManager->componentPool<HealthComponent>().size() == 1U);
+	REQUIRE(entitiesManager->componentPool<HealthComponent>().begin()[0].health == 7);
+
+	std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<TagComponent, HealthComponent>(3U) };
+	REQUIRE(entitiesManager->componentPool<TagComponent>().size() == 3U);
+	REQUIRE(entitiesManager->componentPool<HealthComponent>().size() == 4U);
+	REQUIRE(entitiesManager->componentPool<ecs::LifetimeComponent>().size() == 0U);
+
+	entitiesManager->releaseEntities(std::move(ents));
+	REQUIRE(entitiesManager->componentPool<TagComponent>().size() == 0U);
+	REQUIRE(entitiesManager->componentPool<HealthComponent>().size() == 1U);
 }
 
 TEST_CASE("Entity::groups")
 {
 	// isMemberOf, enrollToGroup, dismissFromGroup
-	ecs::EntitiesManager<2U> entitiesManager{};
+	EntitiesManager<2U> entitiesManager{};
 
-	ecs::EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
+	EntitiesManager<2U>::Entity ent1 = entitiesManager.requestEntity();
 
 	REQUIRE_FALSE(ent1.isMemberOf(ecs::Group::movers));
 	REQUIRE_FALSE(ent1.isMemberOf(ecs::Group::organisms));
@@ -141,30 +221,549 @@ TEST_CASE("Entity::groups")
 
 	REQUIRE(ent1.enrollToGroup(ecs::Group::movers));
 	REQUIRE(ent1.enrollToGroup(ecs::Group::organisms));
+
+	STATIC_REQUIRE(ecs::group_bit(ecs::Group::movers) == 1U);
+	STATIC_REQUIRE(ecs::group_bit(ecs::Group::dummy_group) == 4U);
+}
+
+TEST_CASE("EntitiesPool::members")
+{
+	EntitiesManager<8U> entitiesManager{};
+	ecs::EntitiesPool<8U, ecs::PhysicsComponent, ecs::LifetimeComponent>& entitiesPool{ entitiesManager.entitiesPool() };
+
+	std::vector<EntitiesManager<8U>::Entity> ents{ entitiesManager.requestEntities(6U) };
+	for (std::size_t i{ 0U }; i != ents.size(); ++i)
+	{
+		REQUIRE(ents[i].enrollToGroup(ecs::Group::movers));
+		if (i % 2U == 0U)
+		{
+			REQUIRE(ents[i].enrollToGroup(ecs::Group::organisms));
+		}
+	}
+
+	auto memberIds = [&entitiesPool](ecs::Group group)
+		{
+			std::vector<ecs::EntityId> ids{};
+			for (const auto& entBody : entitiesPool.members(group))
+			{
+				REQUIRE((entBody.groups_ & ecs::group_bit(group)) != 0U);
+				ids.push_back(entBody.id_);
+			}
+			std::ranges::sort(ids);
+			return ids;
+		};
+
+	REQUIRE(entitiesPool.membersCount(ecs::Group::movers) == 6U);
+	REQUIRE(entitiesPool.membersCount(ecs::Group::organisms) == 3U);
+	REQUIRE(entitiesPool.membersCount(ecs::Group::dummy_group) == 0U);
+
+	// Group::emptyVal has no members, and nothing can be enrolled to it
+	REQUIRE(entitiesPool.membersCount(ecs::Group::emptyVal) == 0U);
+	REQUIRE(std::ranges::empty(entitiesPool.members(ecs::Group::emptyVal)));
+	REQUIRE_FALSE(ents[0].enrollToGroup(ecs::Group::emptyVal));
+	REQUIRE_FALSE(ents[0].enrollToGroup(ecs::Group::count));
+	REQUIRE(entitiesPool.membersCount(ecs::Group::count) == 0U);
+	REQUIRE(memberIds(ecs::Group::organisms) == std::vector<ecs::EntityId>{ ents[0].getId(), ents[2].getId(), ents[4].getId() });
+
+	SECTION("dismissing swaps the member out")
+	{
+		REQUIRE(ents[0].dismissFromGroup(ecs::Group::organisms));
+		REQUIRE(memberIds(ecs::Group::organisms) == std::vector<ecs::EntityId>{ ents[2].getId(), ents[4].getId() });
+		REQUIRE(memberIds(ecs::Group::movers).size() == 6U);
+	}
+
+	SECTION("released entities leave their groups")
+	{
+		const ecs::EntityId kept{ ents[4].getId() };
+		std::vector<EntitiesManager<8U>::Entity> released{};
+		released.push_back(std::move(ents[0]));
+		released.push_back(std::move(ents[1]));
+		entitiesManager.releaseEntities(std::move(released));
+		{
+			EntitiesManager<8U>::Entity dropped{ std::move(ents[2]) };
+		}
+
+		REQUIRE(entitiesPool.membersCount(ecs::Group::movers) == 3U);
+		REQUIRE(memberIds(ecs::Group::organisms) == std::vector<ecs::EntityId>{ kept });
+
+		// reused bodies start without groups
+		std::vector<EntitiesManager<8U>::Entity> fresh{ entitiesManager.requestEntities(3U) };
+		for (const EntitiesManager<8U>::Entity& ent : fresh)
+		{
+			REQUIRE_FALSE(ent.isMemberOf(ecs::Group::movers));
+		}
+		REQUIRE(entitiesPool.membersCount(ecs::Group::movers) == 3U);
+	}
+}
+
+TEST_CASE("EntityHandle")
+{
+	STATIC_REQUIRE(std::is_trivially_copyable_v<ecs::EntityHandle>);
+	STATIC_REQUIRE(sizeof(ecs::EntityHandle) == 8U);
+
+	EntitiesManager<2U> entitiesManager{};
+
+	REQUIRE_FALSE(entitiesManager.isAlive(ecs::EntityHandle{}));
+
+	// slots never handed out have no generation yet
+	REQUIRE_FALSE(entitiesManager.isAlive(ecs::EntityHandle{ 0U, 0U }));
+	REQUIRE(entitiesManager.entitiesPool().handleOf(entitiesManager.entitiesPool().begin() + 1U) == ecs::EntityHandle{});
+
+	std::vector<EntitiesManager<2U>::Entity> ents{ entitiesManager.requestEntities<ecs::LifetimeComponent>(2U) };
+	const ecs::EntityHandle first{ ents[0].getHandle() };
+	const ecs::EntityHandle copy{ first };
+
+	REQUIRE(copy == first);
+	REQUIRE(first != ents[1].getHandle());
+	REQUIRE(entitiesManager.isAlive(copy));
+	REQUIRE(entitiesManager.componentOf<ecs::LifetimeComponent>(first) ==
+		std::get<ecs::PooledComponent<ecs::LifetimeComponent, 2U>>(ents[0].getComponent<ecs::LifetimeComponent>()).get());
+	REQUIRE(entitiesManager.componentOf<ecs::PhysicsComponent>(first) == nullptr);
+
+	SECTION("released one by one")
+	{
+		{
+			EntitiesManager<2U>::Entity dropped{ std::move(ents[0]) };
+		}
+		REQUIRE_FALSE(entitiesManager.isAlive(first));
+		REQUIRE(entitiesManager.componentOf<ecs::LifetimeComponent>(first) == nullptr);
+	}
+
+	SECTION("released in a batch")
+	{
+		entitiesManager.releaseEntities(std::move(ents));
+		REQUIRE_FALSE(entitiesManager.isAlive(first));
+	}
+
+	// the slot is reused, the old handle stays stale
+	EntitiesManager<2U>::Entity reused{ entitiesManager.requestEntity() };
+	if (reused.getHandle().index_ == first.index_)
+	{
+		REQUIRE(reused.getHandle().generation_ != first.generation_);
+	}
+	REQUIRE(entitiesManager.isAlive(reused.getHandle()));
+	REQUIRE_FALSE(entitiesManager.isAlive(first));
+}
+
+TEST_CASE("ComponentPool::concurrent request/release")
+{
+	constexpr std::size_t capacity{ 256U };
+	constexpr std::size_t threadsCount{ 4U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::PhysicsComponent, capacity>>() };
+
+	auto worker = [&pool]()
+	{
+		std::vector<ecs::PooledComponent<ecs::PhysicsComponent, capacity>> held{};
+		for (std::size_t round{ 0U }; round != 1000U; ++round)
+		{
+			for (std::size_t i{ 0U }; i != capacity / threadsCount; ++i)
+			{
+				held.push_back(pool->request());
+			}
+			held.clear();
+		}
+	};
+
+	std::vector<std::future<void>> futures{};
+	for (std::size_t t{ 0U }; t != threadsCount; ++t)
+	{
+		futures.push_back(std::async(std::launch::async, worker));
+	}
+	for (std::future<void>& fu : futures)
+	{
+		fu.get();
+	}
+
+	REQUIRE(pool->size() == 0U);
+
+	// every slot must still be handed out exactly once
+	std::vector<ecs::PooledComponent<ecs::PhysicsComponent, capacity>> all{};
+	for (std::size_t i{ 0U }; i != capacity; ++i)
+	{
+		all.push_back(pool->request());
+	}
+	REQUIRE(pool->isFull());
+	REQUIRE_THROWS_AS(pool->request(), ecs::components_max_capacity_exception);
+
+	std::vector<decltype(all.front().get())> ptrs{};
+	for (auto& compo : all)
+	{
+		ptrs.push_back(compo.get());
+	}
+	std::sort(ptrs.begin(), ptrs.end());
+	REQUIRE(std::adjacent_find(ptrs.begin(), ptrs.end()) == ptrs.end());
+}
+
+TEST_CASE("EntitiesPool::per-thread magazines")
+{
+	constexpr std::size_t capacity{ 64U };
+	constexpr std::size_t threadsCount{ 4U };
+
+	auto entitiesManager{ std::make_unique<EntitiesManager<capacity>>() };
+
+	auto worker = [&entitiesManager]()
+	{
+		std::vector<EntitiesManager<capacity>::Entity> held{};
+		for (std::size_t round{ 0U }; round != 200U; ++round)
+		{
+			for (std::size_t i{ 0U }; i != capacity / threadsCount; ++i)
+			{
+				held.push_back(entitiesManager->requestEntity());
+			}
+			held.clear();
+		}
+	};
+
+	std::vector<std::future<void>> futures{};
+	for (std::size_t t{ 0U }; t != threadsCount; ++t)
+	{
+		futures.push_back(std::async(std::launch::async, worker));
+	}
+	for (std::future<void>& fu : futures)
+	{
+		fu.get();
+	}
+
+	REQUIRE(entitiesManager->size() == 0U);
+
+	// a thread's magazine hands back the slot it released last
+	std::uint32_t released{};
+	{
+		EntitiesManager<capacity>::Entity ent{ entitiesManager->requestEntity() };
+		released = ent.getHandle().index_;
+	}
+	REQUIRE(entitiesManager->requestEntity().getHandle().index_ == released);
+
+	// slots cached in the magazines of the threads which exited must still be reachable
+	std::vector<EntitiesManager<capacity>::Entity> all{};
+	for (std::size_t i{ 0U }; i != capacity; ++i)
+	{
+		all.push_back(entitiesManager->requestEntity());
+	}
+	REQUIRE(entitiesManager->isFull());
+	REQUIRE_THROWS_AS(entitiesManager->requestEntity(), ecs::entities_max_capacity_exception);
+}
+
+TEST_CASE("ComponentPool::batches")
+{
+	constexpr std::size_t capacity{ 8U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::LifetimeComponent, capacity>>() };
+
+	auto first{ pool->requestBatch(5U) };
+	REQUIRE(first.size() == 5U);
+	REQUIRE(pool->size() == 5U);
+
+	REQUIRE_THROWS_AS(pool->requestBatch(4U), ecs::components_max_capacity_exception);
+	REQUIRE(pool->size() == 5U);
+
+	auto second{ pool->requestBatch(3U) };
+	REQUIRE(pool->isFull());
+
+	pool->releaseBatch(first);
+	REQUIRE(pool->size() == 3U);
+	REQUIRE(first.front() == nullptr);
+
+	auto third{ pool->requestBatch(5U) };
+	REQUIRE(pool->isFull());
+}
+
+TEST_CASE("ComponentPool::lazy construction")
+{
+	constexpr std::size_t capacity{ 8U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::LifetimeComponent, capacity>>() };
+	const auto slotsOf{ [&pool](const std::vector<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>& compos)
+		{
+			std::vector<std::size_t> slots{};
+			for (const auto& compo : compos)
+			{
+				slots.push_back(pool->slotOf(compo.get()));
+			}
+			return slots;
+		} };
+
+	// untouched slots are handed out in order
+	auto single{ pool->request() };
+	REQUIRE(pool->slotOf(single.get()) == 0U);
+	auto first{ pool->requestBatch(3U) };
+	REQUIRE(slotsOf(first) == std::vector<std::size_t>{ 1U, 2U, 3U });
+
+	// released slots come first, the rest of a batch is taken past the mark
+	first[1U].reset();
+	auto second{ pool->requestBatch(3U) };
+	REQUIRE(slotsOf(second) == std::vector<std::size_t>{ 2U, 4U, 5U });
+
+	// a batch which doesn't fit leaves the slots it claimed free
+	REQUIRE_THROWS_AS(pool->requestBatch(3U), ecs::components_max_capacity_exception);
+	REQUIRE(pool->size() == 6U);
+	auto third{ pool->requestBatch(2U) };
+	REQUIRE(pool->isFull());
+	REQUIRE_THROWS_AS(pool->request(), ecs::components_max_capacity_exception);
+
+	pool->releaseBatch(third);
+	pool->releaseBatch(second);
+	REQUIRE(pool->size() == 3U);
+	auto fourth{ pool->requestBatch(5U) };
+	REQUIRE(pool->isFull());
+}
+
+TEST_CASE("OccupancyBitset")
+{
+	ecs::OccupancyBitset<200U> bitset{};
+
+	REQUIRE(bitset.begin() == bitset.end());
+
+	const std::vector<std::size_t> slots{ 0U, 1U, 63U, 64U, 130U, 199U };
+	for (const std::size_t slot : slots)
+	{
+		bitset.set(slot);
+	}
+	bitset.set(100U);
+	bitset.reset(100U);
+
+	REQUIRE(bitset.test(63U));
+	REQUIRE_FALSE(bitset.test(100U));
+	REQUIRE(bitset.word(1U) == 1U);
+	REQUIRE(bitset.word(2U) == 4U);
+
+	std::vector<std::size_t> iterated{};
+	for (const std::size_t slot : bitset)
+	{
+		iterated.push_back(slot);
+	}
+	REQUIRE(iterated == slots);
+}
+
+TEST_CASE("ComponentPool::live")
+{
+	constexpr std::size_t capacity{ 8U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::LifetimeComponent, capacity>>() };
+
+	REQUIRE(std::ranges::empty(pool->live()));
+
+	std::vector<ecs::PooledComponent<ecs::LifetimeComponent, capacity>> compos{};
+	for (std::size_t i{ 0U }; i != 5U; ++i)
+	{
+		compos.push_back(pool->request());
+		compos.back()->lifetime = static_cast<std::uint32_t>(i);
+	}
+
+	// release from the middle and the front
+	compos.erase(compos.begin() + 2);
+	compos.erase(compos.begin());
+
+	std::vector<ecs::LifetimeComponent*> live{};
+	for (ecs::LifetimeComponent& compo : pool->live())
+	{
+		live.push_back(&compo);
+	}
+	REQUIRE(live.size() == 3U);
+
+	std::vector<ecs::LifetimeComponent*> held{};
+	for (auto& compo : compos)
+	{
+		held.push_back(compo.get());
+	}
+	std::ranges::sort(live);
+	std::ranges::sort(held);
+	REQUIRE(live == held);
+
+	compos.clear();
+	REQUIRE(std::ranges::empty(pool->live()));
+}
+
+TEST_CASE("ComponentPool::SoA columns")
+{
+	constexpr std::size_t capacity{ 8U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::PhysicsComponent, capacity>>() };
+
+	std::vector<ecs::PooledComponent<ecs::PhysicsComponent, capacity>> compos{ pool->requestBatch(3U) };
+	for (std::size_t i{ 0U }; i != compos.size(); ++i)
+	{
+		compos[i]->xPos = static_cast<float>(i);
+		compos[i]->yVelocity = 0.5f;
+	}
+
+	auto xPos{ pool->column<&ecs::PhysicsComponent::xPos>() };
+	auto yVelocity{ pool->column<&ecs::PhysicsComponent::yVelocity>() };
+	STATIC_REQUIRE(std::same_as<decltype(xPos), std::span<float, capacity>>);
+
+	for (std::size_t i{ 0U }; i != compos.size(); ++i)
+	{
+		const std::size_t slot{ compos[i].get().slot() };
+		REQUIRE(xPos[slot] == static_cast<float>(i));
+		REQUIRE(yVelocity[slot] == 0.5f);
+	}
+
+	// writes through the columns are visible through the PooledComponents
+	xPos[compos[1].get().slot()] = 42.0f;
+	REQUIRE(compos[1]->xPos == 42.0f);
+	REQUIRE(compos[1]->yPos == 0.0f);
+
+	// a requested slot is value initialized again
+	const std::size_t reusedSlot{ compos[1].get().slot() };
+	compos[1].reset();
+	auto reused{ pool->request() };
+	REQUIRE(reused.get().slot() == reusedSlot);
+	REQUIRE(reused->xPos == 0.0f);
+	REQUIRE(reused->yVelocity == 0.0f);
+
+	// fields read and written in the same expression, each -> refers straight to the columns
+	ecs::PooledComponent<ecs::PhysicsComponent, capacity>& p{ compos[2] };
+	p->xPos = 1.0f;
+	p->xVelocity = 1.0f;
+	p->xPos += p->xVelocity;
+	REQUIRE(p->xPos == 2.0f);
+	p->yPos = p->xVelocity + 2.0f;
+	REQUIRE(p->yPos == 3.0f);
+	p->xPos = p->xPos * p->yPos + p->xPos;
+	REQUIRE(p->xPos == 8.0f);
+	p->yVelocity = (p->xVelocity = 4.0f) + p->yPos;
+	REQUIRE(p->xVelocity == 4.0f);
+	REQUIRE(p->yVelocity == 7.0f);
+	REQUIRE(p->yPos == 3.0f);
+	REQUIRE(xPos[p.get().slot()] == 8.0f);
+
+	// * yields the same references, and whole components are gathered and scattered through it
+	(*p.get()).xPos -= 1.0f;
+	REQUIRE(xPos[p.get().slot()] == 7.0f);
+	const ecs::PhysicsComponent copy = *p.get();
+	REQUIRE(copy.xPos == 7.0f);
+	REQUIRE(copy.yPos == 3.0f);
+	REQUIRE(copy.xVelocity == 4.0f);
+	REQUIRE(copy.yVelocity == 7.0f);
+	*compos[0].get() = copy;
+	REQUIRE(compos[0]->yVelocity == 7.0f);
+	REQUIRE(xPos[compos[0].get().slot()] == 7.0f);
+
+	// live() yields the live slots' references in slot order
+	std::size_t liveCount{ 0U };
+	for (auto physics : pool->live())
+	{
+		physics.yPos = -1.0f;
+		++liveCount;
+	}
+	REQUIRE(liveCount == 3U);
+	REQUIRE(reused->yPos == -1.0f);
+	REQUIRE(p->yPos == -1.0f);
+}
+
+TEST_CASE("move kernels")
+{
+	// not a multiple of 8, so the last group of slots is partial
+	constexpr std::size_t capacity{ 203U };
+
+	auto pool{ std::make_unique<ecs::ComponentPool<ecs::PhysicsComponent, capacity>>() };
+	std::vector<ecs::PooledComponent<ecs::PhysicsComponent, capacity>> compos{ pool->requestBatch(capacity) };
+
+	auto xPos{ pool->column<&ecs::PhysicsComponent::xPos>() };
+	auto yPos{ pool->column<&ecs::PhysicsComponent::yPos>() };
+	auto xVelocity{ pool->column<&ecs::PhysicsComponent::xVelocity>() };
+	auto yVelocity{ pool->column<&ecs::PhysicsComponent::yVelocity>() };
+
+	// release every third component, plus a whole word of slots
+	for (std::size_t i{ 0U }; i != capacity; ++i)
+	{
+		if (i % 3U == 0U || (i >= 64U && i < 128U))
+		{
+			compos[i].reset();
+		}
+	}
+
+	const ecs::SimdLevel supported{ ecs::detect_simd_level() };
+	for (const ecs::SimdLevel level : { ecs::SimdLevel::scalar, ecs::SimdLevel::sse2, ecs::SimdLevel::avx2 })
+	{
+		if (level > supported)
+		{
+			continue;
+		}
+
+		for (std::size_t slot{ 0U }; slot != capacity; ++slot)
+		{
+			xPos[slot] = static_cast<float>(slot);
+			yPos[slot] = -static_cast<float>(slot);
+			xVelocity[slot] = 1.0f;
+			yVelocity[slot] = 0.5f;
+		}
+
+		const ecs::MoveColumns columns{ xPos.data(), yPos.data(), xVelocity.data(), yVelocity.data() };
+		ecs::move_kernels::for_level(level)(columns, pool->occupancy().words());
+
+		for (std::size_t slot{ 0U }; slot != capacity; ++slot)
+		{
+			const bool live{ pool->occupancy().test(slot) };
+			REQUIRE(xPos[slot] == static_cast<float>(slot) + (live ? 1.0f : 0.0f));
+			REQUIRE(yPos[slot] == -static_cast<float>(slot) + (live ? 0.5f : 0.0f));
+		}
+	}
+}
+
+TEST_CASE("EntitiesManager::batches")
+{
+	// requestEntities, addComponents, releaseEntities
+	constexpr std::size_t capacity{ 64U };
+
+	auto entitiesManager{ std::make_unique<EntitiesManager<capacity>>() };
+
+	std::vector<EntitiesManager<capacity>::Entity> movers{ 
+		entitiesManager->requestEntities<ecs::PhysicsComponent>(40U) };
+	REQUIRE(movers.size() == 40U);
+	REQUIRE(entitiesManager->size() == 40U);
+	for (std::size_t i{ 1U }; i != movers.size(); ++i)
+	{
+		REQUIRE(movers[i].getId() == movers[i - 1U].getId() + 1U);
+	}
+
+	REQUIRE(movers[3].removeComponent<ecs::PhysicsComponent>());
+	REQUIRE(entitiesManager->addComponents<ecs::PhysicsComponent, ecs::LifetimeComponent>(movers) == 41U);
+	for (auto& ent : movers)
+	{
+		REQUIRE(ent.hasComponent<ecs::PhysicsComponent>());
+		REQUIRE(ent.hasComponent<ecs::LifetimeComponent>());
+	}
+
+	std::vector<EntitiesManager<capacity>::Entity> others{ entitiesManager->requestEntities(24U) };
+	REQUIRE(entitiesManager->isFull());
+	REQUIRE_FALSE(others.front().hasComponent<ecs::LifetimeComponent>());
+	REQUIRE_THROWS_AS(entitiesManager->requestEntities(1U), ecs::entities_max_capacity_exception);
+
+	entitiesManager->releaseEntities(std::move(movers));
+	REQUIRE(entitiesManager->size() == 24U);
+
+	// every released component must be available again
+	REQUIRE(entitiesManager->addComponents<ecs::PhysicsComponent, ecs::LifetimeComponent>(others) == 48U);
+	std::vector<EntitiesManager<capacity>::Entity> spawned{ 
+		entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(16U) };
+	REQUIRE_THROWS_AS(entitiesManager->requestEntities<ecs::PhysicsComponent>(25U), ecs::entities_max_capacity_exception);
+	REQUIRE(entitiesManager->size() == 40U);
 }
 
 TEST_CASE("systems")
 {
-	ecs::EntitiesManager<8U> entitiesManager{};
+	EntitiesManager<8U> entitiesManager{};
 
-	ecs::EntitiesManager<8U>::Entity ent1 = entitiesManager.requestEntity();
-	ecs::EntitiesManager<8U>::Entity ent2 = entitiesManager.requestEntity();
-	ecs::EntitiesManager<8U>::Entity ent3 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent1 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent2 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent3 = entitiesManager.requestEntity();
 
 	REQUIRE(ent1.addComponent<ecs::PhysicsComponent>());
 	REQUIRE(ent2.addComponent<ecs::PhysicsComponent>());
 	REQUIRE(ent3.addComponent<ecs::PhysicsComponent>());
 
-	ecs::EntitiesManager<8U>::Entity ent4 = entitiesManager.requestEntity();
-	ecs::EntitiesManager<8U>::Entity ent5 = entitiesManager.requestEntity();
-	ecs::EntitiesManager<8U>::Entity ent6 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent4 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent5 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent6 = entitiesManager.requestEntity();
 
 	REQUIRE(ent4.addComponent<ecs::LifetimeComponent>());
 	REQUIRE(ent5.addComponent<ecs::LifetimeComponent>());
 	REQUIRE(ent6.addComponent<ecs::LifetimeComponent>());
 
-	ecs::EntitiesManager<8U>::Entity ent7 = entitiesManager.requestEntity();
-	ecs::EntitiesManager<8U>::Entity ent8 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent7 = entitiesManager.requestEntity();
+	EntitiesManager<8U>::Entity ent8 = entitiesManager.requestEntity();
 
 	REQUIRE(ent7.addComponent<ecs::PhysicsComponent>());
 	REQUIRE(ent7.addComponent<ecs::LifetimeComponent>());
@@ -174,11 +773,998 @@ TEST_CASE("systems")
 	REQUIRE(ent7.enrollToGroup(ecs::Group::dummy_group));
 	REQUIRE(ent8.enrollToGroup(ecs::Group::dummy_group));
 
-	std::future<void> fuMove = std::async(std::launch::async, ecs::move_system<8U>, std::ref(entitiesManager));
-	std::future<void> fuDec = std::async(std::launch::async, ecs::decrease_lifetime_system<8U>, std::ref(entitiesManager));
-	std::future<void> fuDummy = std::async(std::launch::async, ecs::dummy_system<8U>, std::ref(entitiesManager));
+	ecs::ThreadPool threadPool{ 2U };
+	std::atomic<int> running{ 3 };
+	threadPool.submit([&]() { ecs::move_system(entitiesManager); --running; });
+	threadPool.submit([&]() { ecs::decrease_lifetime_system(entitiesManager); --running; });
+	threadPool.submit([&]() { ecs::dummy_system(entitiesManager); --running; });
+	threadPool.runUntil([&running]() { return running == 0; });
+
+	REQUIRE(ent1.removeComponent<ecs::PhysicsComponent>());
+
+	auto& physCompo{ std::get<ecs::PooledComponent<ecs::PhysicsComponent, 8U>>(ent2.getComponent<ecs::PhysicsComponent>()) };
+	physCompo->xVelocity = 1.5f;
+	physCompo->yVelocity = -2.0f;
+
+	ecs::move_system(entitiesManager);
+
+	REQUIRE(physCompo->xPos == 1.5f);
+	REQUIRE(physCompo->yPos == -2.0f);
+}
+
+TEST_CASE("ThreadPool")
+{
+	ecs::ThreadPool threadPool{ 3U };
+
+	// tasks submitted from tasks land in the worker's own deque, and are stolen by the others
+	constexpr int tasksCount{ 1000 };
+	std::atomic<int> ran{ 0 };
+	for (int i{ 0 }; i != tasksCount; ++i)
+	{
+		threadPool.submit([&]()
+			{
+				++ran;
+				threadPool.submit([&ran]() { ++ran; });
+			});
+	}
+	threadPool.runUntil([&ran]() { return ran == 2 * tasksCount; });
+
+	// parallelFor inside a task helps with queued tasks instead of blocking a worker
+	std::atomic<int> sum{ 0 };
+	std::atomic<int> outerDone{ 0 };
+	for (int i{ 0 }; i != 8; ++i)
+	{
+		threadPool.submit([&]()
+			{
+				threadPool.parallelFor(100U, [&sum](std::size_t idx) { sum += static_cast<int>(idx); });
+				++outerDone;
+			});
+	}
+	threadPool.runUntil([&outerDone]() { return outerDone == 8; });
+	REQUIRE(sum == 8 * 4950);
+
+	// a pool without workers runs everything on the waiting thread
+	ecs::ThreadPool inlinePool{ 0U };
+	bool inlineRan{ false };
+	inlinePool.submit([&inlineRan]() { inlineRan = true; });
+	inlinePool.runUntil([&inlineRan]() { return inlineRan; });
+	REQUIRE(inlinePool.workersCount() == 0U);
+}
+
+
+TEST_CASE("parallel systems")
+{
+	ecs::ThreadPool threadPool{ 3U };
+
+	SECTION("chunks")
+	{
+		constexpr std::size_t slotsCount{ 1000U };
+
+		std::vector<std::atomic<int>> hits(slotsCount);
+		std::mutex mutex{};
+		std::vector<ecs::SlotChunk> chunks{};
+		ecs::parallel_for_chunks(threadPool, slotsCount, 100U, [&](ecs::SlotChunk chunk)
+			{
+				for (std::size_t slot{ chunk.begin }; slot != chunk.end; ++slot)
+				{
+					++hits[slot];
+				}
+				std::lock_guard lock{ mutex };
+				chunks.push_back(chunk);
+			});
+
+		// rounded up to 128 slots, whatever the number of threads
+		std::ranges::sort(chunks, {}, &ecs::SlotChunk::begin);
+		REQUIRE(chunks.size() == 8U);
+		for (std::size_t i{ 0U }; i != chunks.size(); ++i)
+		{
+			REQUIRE(chunks[i].begin == i * 128U);
+			REQUIRE(chunks[i].end == std::min((i + 1U) * 128U, slotsCount));
+		}
+		REQUIRE(std::ranges::all_of(hits, [](const std::atomic<int>& hit) { return hit.load() == 1; }));
+	}
+
+	SECTION("same results as serial")
+	{
+		// a few chunks, the last one partial
+		constexpr std::size_t capacity{ 3U * ecs::defaultChunkSlots - 100U };
+		using Manager = EntitiesManager<capacity>;
+
+		auto serialManager{ std::make_unique<Manager>() };
+		auto parallelManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> serialEnts{ serialManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(capacity) };
+		std::vector<Manager::Entity> parallelEnts{ parallelManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(capacity) };
+
+		for (std::size_t i{ 0U }; i != capacity; ++i)
+		{
+			for (std::vector<Manager::Entity>* ents : { &serialEnts, &parallelEnts })
+			{
+				Manager::Entity& ent{ (*ents)[i] };
+				if (i % 7U == 0U)
+				{
+					REQUIRE(ent.removeComponent<ecs::PhysicsComponent>());
+					REQUIRE(ent.removeComponent<ecs::LifetimeComponent>());
+					continue;
+				}
+
+				auto& physCompo{ std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(ent.getComponent<ecs::PhysicsComponent>()) };
+				physCompo->xPos = static_cast<float>(i);
+				physCompo->xVelocity = 0.25f;
+				physCompo->yVelocity = -1.0f;
+				std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime = 10U;
+			}
+		}
+
+		ecs::move_system(*serialManager);
+		ecs::decrease_lifetime_system(*serialManager);
+		ecs::parallel_move_system(*parallelManager, threadPool);
+		ecs::parallel_decrease_lifetime_system(*parallelManager, threadPool);
+
+		for (std::size_t i{ 0U }; i != capacity; ++i)
+		{
+			if (i % 7U == 0U)
+			{
+				continue;
+			}
 
-	fuMove.get();
-	fuDec.get();
-	fuDummy.get();
-}
\ No newline at end of file
+			auto& serialPhys{ std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(serialEnts[i].getComponent<ecs::PhysicsComponent>()) };
+			auto& parallelPhys{ std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(parallelEnts[i].getComponent<ecs::PhysicsComponent>()) };
+			REQUIRE(parallelPhys->xPos == serialPhys->xPos);
+			REQUIRE(parallelPhys->yPos == serialPhys->yPos);
+			REQUIRE(parallelPhys->xPos == static_cast<float>(i) + 0.25f);
+
+			auto& parallelLifetime{ std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(parallelEnts[i].getComponent<ecs::LifetimeComponent>()) };
+			REQUIRE(parallelLifetime->lifetime == 9U);
+		}
+	}
+}
+
+
+// stands for as many distinct resources as needed
+template <std::size_t N>
+struct Resource {};
+
+TEST_CASE("Scheduler")
+{
+	ecs::ThreadPool threadPool{ 3U };
+	ecs::Scheduler scheduler{ threadPool };
+
+	SECTION("conflicting systems are serialized in order")
+	{
+		// one flag per resource, raised while a system writes it
+		std::atomic<bool> writingPhysics{ false };
+		std::atomic<bool> writingLifetime{ false };
+		std::atomic<bool> overlapped{ false };
+		std::mutex mutex{};
+		std::vector<int> order{};
+
+		auto write = [&](std::atomic<bool>& writing, int id)
+		{
+			if (writing.exchange(true))
+			{
+				overlapped = true;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+			{
+				std::lock_guard lock{ mutex };
+				order.push_back(id);
+			}
+			writing = false;
+		};
+
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::PhysicsComponent>>([&]() { write(writingPhysics, 0); });
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::LifetimeComponent>>([&]() { write(writingLifetime, 1); });
+		scheduler.addSystem<ecs::Reads<ecs::LifetimeComponent>, ecs::Writes<ecs::PhysicsComponent>>([&]() { write(writingPhysics, 2); });
+		scheduler.addSystem<ecs::Reads<ecs::PhysicsComponent>, ecs::Writes<>>([&]()
+			{
+				if (writingPhysics)
+				{
+					overlapped = true;
+				}
+				std::lock_guard lock{ mutex };
+				order.push_back(3);
+			});
+		REQUIRE(scheduler.systemsCount() == 4U);
+
+		for (int frame{ 0 }; frame != 20; ++frame)
+		{
+			order.clear();
+			scheduler.runFrame();
+
+			REQUIRE(order.size() == 4U);
+			const auto position = [&order](int id) { return std::ranges::find(order, id) - order.begin(); };
+			REQUIRE(position(0) < position(2));
+			REQUIRE(position(1) < position(2));
+			REQUIRE(position(2) < position(3));
+		}
+		REQUIRE_FALSE(overlapped);
+	}
+
+	SECTION("more than 64 resources")
+	{
+		std::atomic<bool> written{ false };
+		std::atomic<bool> overlapped{ false };
+
+		// writes 80 resources, so the ids of most of them are past the first 64
+		[&]<std::size_t... Ns>(std::index_sequence<Ns...>)
+		{
+			scheduler.addSystem<ecs::Reads<>, ecs::Writes<Resource<Ns>...>>([&]()
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds{ 1 });
+					written = true;
+				});
+		}(std::make_index_sequence<80U>{});
+		scheduler.addSystem<ecs::Reads<Resource<79U>>, ecs::Writes<>>([&]()
+			{
+				if (!written)
+				{
+					overlapped = true;
+				}
+			});
+
+		for (int frame{ 0 }; frame != 10; ++frame)
+		{
+			written = false;
+			scheduler.runFrame();
+		}
+		REQUIRE_FALSE(overlapped);
+	}
+
+	SECTION("exceptions reach runFrame")
+	{
+		std::atomic<int> ran{ 0 };
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::PhysicsComponent>>([]() { throw std::runtime_error{ "system failed" }; });
+		scheduler.addSystem<ecs::Reads<ecs::PhysicsComponent>, ecs::Writes<>>([&ran]() { ++ran; });
+		scheduler.addSystem<ecs::Reads<ecs::EntityBodies>, ecs::Writes<>>([&ran]() { ++ran; });
+
+		REQUIRE_THROWS_AS(scheduler.runFrame(), std::runtime_error);
+		REQUIRE(ran == 2);
+	}
+
+	SECTION("systems")
+	{
+		using Manager = EntitiesManager<8U>;
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(4U) };
+		for (Manager::Entity& ent : ents)
+		{
+			auto& physCompo{ std::get<ecs::PooledComponent<ecs::PhysicsComponent, 8U>>(ent.getComponent<ecs::PhysicsComponent>()) };
+			physCompo->xVelocity = 1.0f;
+			std::get<ecs::PooledComponent<ecs::LifetimeComponent, 8U>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime = 5U;
+		}
+
+		Manager& manager{ *entitiesManager };
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::PhysicsComponent>>([&manager]() { ecs::move_system(manager); });
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::LifetimeComponent>>([&manager]() { ecs::decrease_lifetime_system(manager); });
+		scheduler.addSystem<ecs::Reads<ecs::EntityBodies>, ecs::Writes<>>([&manager]() { ecs::dummy_system(manager); });
+
+		for (int frame{ 0 }; frame != 3; ++frame)
+		{
+			scheduler.runFrame();
+		}
+
+		for (Manager::Entity& ent : ents)
+		{
+			REQUIRE(std::get<ecs::PooledComponent<ecs::PhysicsComponent, 8U>>(ent.getComponent<ecs::PhysicsComponent>())->xPos == 3.0f);
+			REQUIRE(std::get<ecs::PooledComponent<ecs::LifetimeComponent, 8U>>(ent.getComponent<ecs::LifetimeComponent>())->lifetime == 2U);
+		}
+	}
+}
+
+
+TEST_CASE("CommandBuffer")
+{
+	using Manager = EntitiesManager<64U>;
+	auto entitiesManager{ std::make_unique<Manager>() };
+	ecs::ThreadPool threadPool{ 2U };
+	ecs::CommandBuffer<64U, ecs::PhysicsComponent, ecs::LifetimeComponent> commands{ *entitiesManager, threadPool };
+
+	std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(8U) };
+
+	SECTION("nothing changes before playback")
+	{
+		commands.destroy(ents[0].getHandle());
+		commands.addComponent<ecs::PhysicsComponent>(ents[1].getHandle());
+		commands.spawn<ecs::PhysicsComponent>();
+
+		REQUIRE(commands.size() == 3U);
+		REQUIRE(entitiesManager->size() == 8U);
+		REQUIRE_FALSE(ents[1].hasComponent<ecs::PhysicsComponent>());
+
+		REQUIRE(commands.playback(ents) == 3U);
+		REQUIRE(commands.size() == 0U);
+		REQUIRE(entitiesManager->size() == 8U);
+		REQUIRE(ents.size() == 8U);
+		REQUIRE(std::ranges::count_if(ents, [](const Manager::Entity& ent) { return ent.hasComponent<ecs::PhysicsComponent>(); }) == 2);
+	}
+
+	SECTION("removals, additions, destructions and spawns")
+	{
+		const ecs::EntityHandle doomed{ ents[2].getHandle() };
+		const ecs::EntityId keptId{ ents[3].getId() };
+		commands.removeComponent<ecs::LifetimeComponent>(ents[3].getHandle());
+		commands.addComponent<ecs::PhysicsComponent>(doomed);
+		commands.destroy(doomed);
+		commands.destroy(doomed);
+		commands.spawn<ecs::PhysicsComponent, ecs::LifetimeComponent>();
+		commands.spawn<>();
+
+		REQUIRE(commands.playback(ents) == 5U);
+
+		REQUIRE_FALSE(entitiesManager->isAlive(doomed));
+		REQUIRE(ents.size() == 9U);
+		REQUIRE(entitiesManager->size() == 9U);
+		REQUIRE(entitiesManager->componentPool<ecs::LifetimeComponent>().size() == 7U);
+		REQUIRE(entitiesManager->componentPool<ecs::PhysicsComponent>().size() == 1U);
+
+		const auto kept{ std::ranges::find_if(ents, [keptId](const Manager::Entity& ent) { return ent.getId() == keptId; }) };
+		REQUIRE(kept != ents.end());
+		REQUIRE_FALSE(kept->hasComponent<ecs::LifetimeComponent>());
+
+		// stale handles are skipped
+		commands.destroy(doomed);
+		commands.addComponent<ecs::PhysicsComponent>(doomed);
+		REQUIRE(commands.playback(ents) == 0U);
+		REQUIRE(ents.size() == 9U);
+	}
+
+	SECTION("recorded from parallel systems")
+	{
+		for (std::size_t i{ 0U }; i != ents.size(); ++i)
+		{
+			std::get<ecs::PooledComponent<ecs::LifetimeComponent, 64U>>(ents[i].getComponent<ecs::LifetimeComponent>())->lifetime = 
+				static_cast<std::uint32_t>(i % 3U + 1U);
+		}
+
+		ecs::parallel_decrease_lifetime_system(*entitiesManager, threadPool, commands);
+		REQUIRE(entitiesManager->size() == 8U);
+		REQUIRE(commands.playback(ents) == 3U);
+		REQUIRE(ents.size() == 5U);
+
+		ecs::parallel_decrease_lifetime_system(*entitiesManager, threadPool, commands);
+		REQUIRE(commands.playback(ents) == 3U);
+		REQUIRE(ents.size() == 2U);
+		REQUIRE(entitiesManager->size() == 2U);
+		REQUIRE(entitiesManager->componentPool<ecs::LifetimeComponent>().size() == 2U);
+	}
+
+	SECTION("full pools")
+	{
+		// a single PhysicsComponent slot is left
+		std::vector<ecs::PooledComponent<ecs::PhysicsComponent, 64U>> held{ 
+			entitiesManager->componentPool<ecs::PhysicsComponent>().requestBatch(63U) };
+
+		commands.addComponent<ecs::PhysicsComponent>(ents[0].getHandle());
+		commands.addComponent<ecs::PhysicsComponent>(ents[1].getHandle());
+		commands.spawn<ecs::PhysicsComponent>();
+		commands.spawn<ecs::LifetimeComponent>();
+		commands.spawn<ecs::LifetimeComponent>();
+		for (std::size_t i{ 0U }; i != 60U; ++i)
+		{
+			commands.spawn<>();
+		}
+
+		// the second addition, the PhysicsComponent spawn and the run of 60 bare spawns are skipped
+		REQUIRE(commands.playback(ents) == 3U);
+		REQUIRE(commands.size() == 0U);
+		REQUIRE(ents[0].hasComponent<ecs::PhysicsComponent>());
+		REQUIRE_FALSE(ents[1].hasComponent<ecs::PhysicsComponent>());
+		REQUIRE(ents.size() == 10U);
+		REQUIRE(entitiesManager->size() == 10U);
+		REQUIRE(entitiesManager->componentPool<ecs::PhysicsComponent>().isFull());
+		REQUIRE(entitiesManager->componentPool<ecs::LifetimeComponent>().size() == 10U);
+
+		// the skipped commands aren't kept either
+		held.clear();
+		REQUIRE(commands.playback(ents) == 0U);
+		REQUIRE(entitiesManager->componentPool<ecs::PhysicsComponent>().size() == 1U);
+	}
+}
+
+TEST_CASE("EntitiesManager::owned")
+{
+	using Manager = EntitiesManager<16U>;
+	auto entitiesManager{ std::make_unique<Manager>() };
+
+	std::vector<Manager::Entity> ents{ entitiesManager->requestEntities(10U) };
+	for (std::size_t i{ 0U }; i < ents.size(); i += 3U)
+	{
+		REQUIRE(ents[i].addComponent<ecs::LifetimeComponent>());
+		std::get<ecs::PooledComponent<ecs::LifetimeComponent, 16U>>(ents[i].getComponent<ecs::LifetimeComponent>())->lifetime = 
+			static_cast<std::uint32_t>(i + 1U);
+	}
+	REQUIRE(ents[3].removeComponent<ecs::LifetimeComponent>());
+
+	std::size_t visited{ 0U };
+	for (auto [owner, lifetimeComp] : entitiesManager->owned<ecs::LifetimeComponent>())
+	{
+		const std::size_t i{ lifetimeComp.lifetime - 1U };
+		REQUIRE(owner == ents[i].getHandle());
+		REQUIRE(entitiesManager->ownerOf<ecs::LifetimeComponent>(&lifetimeComp) == owner);
+		REQUIRE(entitiesManager->componentOf<ecs::LifetimeComponent>(owner) == &lifetimeComp);
+		++visited;
+	}
+	REQUIRE(visited == 3U);
+
+	SECTION("expired owners are destroyed")
+	{
+		ecs::ThreadPool threadPool{ 0U };
+		ecs::CommandBuffer<16U, ecs::PhysicsComponent, ecs::LifetimeComponent> commands{ *entitiesManager, threadPool };
+
+		ecs::decrease_lifetime_system(*entitiesManager, commands);
+		REQUIRE(commands.playback(ents) == 1U);
+		REQUIRE(ents.size() == 9U);
+		REQUIRE(entitiesManager->componentPool<ecs::LifetimeComponent>().size() == 2U);
+	}
+
+	SECTION("components no entity holds have no owner")
+	{
+		// the slot of the destroyed entity's component is handed out again, straight from its pool
+		ents.pop_back();
+		ecs::PooledComponent<ecs::LifetimeComponent, 16U> unattached{ entitiesManager->componentPool<ecs::LifetimeComponent>().request() };
+		unattached->lifetime = 100U;
+		REQUIRE(entitiesManager->ownerOf<ecs::LifetimeComponent>(unattached.get()) == ecs::EntityHandle{});
+
+		std::size_t unowned{ 0U };
+		for (auto [owner, lifetimeComp] : entitiesManager->owned<ecs::LifetimeComponent>())
+		{
+			if (owner == ecs::EntityHandle{})
+			{
+				REQUIRE(lifetimeComp.lifetime == 100U);
+				++unowned;
+			}
+		}
+		REQUIRE(unowned == 1U);
+
+		// nor does a view, driven by the component pool, visit it
+		std::size_t viewed{ 0U };
+		for (auto [lifetimeComp] : entitiesManager->view<ecs::LifetimeComponent>())
+		{
+			REQUIRE(lifetimeComp.lifetime != 100U);
+			++viewed;
+		}
+		REQUIRE(viewed == 2U);
+	}
+}
+
+TEST_CASE("make_page_backed")
+{
+	constexpr std::size_t capacity{ 1U << 16U };
+	using Manager = EntitiesManager<capacity>;
+
+	for (const ecs::PagePolicy policy : { ecs::PagePolicy::heap, ecs::PagePolicy::mmap, ecs::PagePolicy::hugePages })
+	{
+		ecs::PageBacked<Manager> entitiesManager{ ecs::make_page_backed<Manager>(policy) };
+
+		// only ever falls back towards the heap
+		REQUIRE(static_cast<int>(entitiesManager.get_deleter().policy()) <= static_cast<int>(policy));
+		REQUIRE(reinterpret_cast<std::uintptr_t>(entitiesManager.get()) % alignof(Manager) == 0U);
+
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::PhysicsComponent, ecs::LifetimeComponent>(capacity) };
+		REQUIRE(entitiesManager->isFull());
+
+		// the pools' storage is placed along with the manager
+		const auto placed = [&entitiesManager](const void* address)
+			{
+				const std::uintptr_t first{ reinterpret_cast<std::uintptr_t>(entitiesManager.get()) };
+				return reinterpret_cast<std::uintptr_t>(address) - first < sizeof(Manager);
+			};
+		REQUIRE(placed(std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(ents.front().getComponent<ecs::LifetimeComponent>()).get()));
+		REQUIRE(placed(std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(ents.back().getComponent<ecs::LifetimeComponent>()).get()));
+		REQUIRE(placed(entitiesManager->entitiesPool().begin() + capacity - 1U));
+		entitiesManager->releaseEntities(std::move(ents));
+		REQUIRE(entitiesManager->size() == 0U);
+	}
+
+	ecs::PageBacked<ecs::ComponentPool<ecs::PhysicsComponent, capacity>> pool{ 
+		ecs::make_page_backed<ecs::ComponentPool<ecs::PhysicsComponent, capacity>>(ecs::PagePolicy::hugePages) };
+	REQUIRE(pool->request());
+}
+
+TEST_CASE("LifetimeWheel")
+{
+	constexpr std::size_t entitiesCount{ 64U };
+	auto wheel{ std::make_unique<ecs::LifetimeWheel<entitiesCount>>() };
+
+	SECTION("every entity expires exactly on its tick, across all levels")
+	{
+		// spread over the first three levels, some ending right on a level boundary
+		std::vector<std::uint64_t> expiries(entitiesCount);
+		for (std::uint32_t i{ 0U }; i != entitiesCount; ++i)
+		{
+			const std::uint32_t lifetime{ i % 4U == 0U ? (1U << (i % 24U)) : (i * 2654435761U) % 200000U };
+			REQUIRE(wheel->schedule(ecs::EntityHandle{ i, 0U }, lifetime));
+			expiries[i] = std::max(lifetime, 1U);
+		}
+
+		std::size_t expiredCount{ 0U };
+		const std::uint64_t lastExpiry{ *std::ranges::max_element(expiries) };
+		while (wheel->now() != lastExpiry)
+		{
+			for (const ecs::EntityHandle handle : wheel->advance())
+			{
+				REQUIRE(expiries[handle.index_] == wheel->now());
+				++expiredCount;
+			}
+		}
+		REQUIRE(expiredCount == entitiesCount);
+	}
+
+	SECTION("cancelled and rescheduled entities")
+	{
+		REQUIRE(wheel->schedule(ecs::EntityHandle{ 0U, 0U }, 3U));
+		REQUIRE(wheel->schedule(ecs::EntityHandle{ 1U, 0U }, 3U));
+		REQUIRE(wheel->schedule(ecs::EntityHandle{ 2U, 0U }, 300U));
+		wheel->cancel(ecs::EntityHandle{ 1U, 0U });
+		REQUIRE(!wheel->schedule(ecs::EntityHandle{}, 1U));
+		REQUIRE(!wheel->schedule(ecs::EntityHandle{ entitiesCount, 0U }, 1U));
+		wheel->cancel(ecs::EntityHandle{});
+		REQUIRE(wheel->schedule(ecs::EntityHandle{ 2U, 0U }, 2U));
+
+		REQUIRE(wheel->advance().empty());
+		REQUIRE(wheel->advance().size() == 1U);
+		REQUIRE(wheel->advance().front() == ecs::EntityHandle{ 0U, 0U });
+		for (std::size_t tick{ 0U }; tick != 400U; ++tick)
+		{
+			REQUIRE(wheel->advance().empty());
+		}
+	}
+
+	SECTION("expired entities are destroyed through a command buffer")
+	{
+		using Manager = EntitiesManager<entitiesCount>;
+		auto entitiesManager{ std::make_unique<Manager>() };
+		ecs::ThreadPool threadPool{ 0U };
+		ecs::CommandBuffer<entitiesCount, ecs::PhysicsComponent, ecs::LifetimeComponent> commands{ *entitiesManager, threadPool };
+
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities(10U) };
+		for (std::uint32_t i{ 0U }; i != ents.size(); ++i)
+		{
+			REQUIRE(wheel->schedule(ents[i].getHandle(), i / 2U + 1U));
+		}
+
+		for (std::size_t tick{ 1U }; tick != 6U; ++tick)
+		{
+			ecs::expire_lifetimes_system(*wheel, commands);
+			REQUIRE(commands.playback(ents) == 2U);
+			REQUIRE(ents.size() == 10U - 2U * tick);
+		}
+	}
+}
+
+TEST_CASE("instrumentation")
+{
+	REQUIRE(ecs::instrumentation::enabled);
+
+	// events recorded by the other tests
+	static_cast<void>(ecs::instrumentation::drain_events());
+
+	SECTION("systems are timed per frame")
+	{
+		EntitiesManager<8U> entitiesManager{};
+		std::vector<EntitiesManager<8U>::Entity> movers{ entitiesManager.requestEntities<ecs::PhysicsComponent>(3U) };
+		std::vector<EntitiesManager<8U>::Entity> mortals{ entitiesManager.requestEntities<ecs::LifetimeComponent>(2U) };
+
+		ecs::ThreadPool threadPool{ 1U };
+		ecs::Scheduler scheduler{ threadPool };
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::PhysicsComponent>>([&entitiesManager]() { ecs::move_system(entitiesManager); });
+		scheduler.addSystem<ecs::Reads<>, ecs::Writes<ecs::LifetimeComponent>>([&entitiesManager]() { ecs::decrease_lifetime_system(entitiesManager); });
+
+		const std::uint64_t frame{ ecs::instrumentation::current_frame() };
+		scheduler.runFrame();
+		scheduler.runFrame();
+		REQUIRE(ecs::instrumentation::current_frame() == frame + 2U);
+
+		const std::vector<ecs::instrumentation::Event> events{ ecs::instrumentation::drain_events() };
+		REQUIRE(std::ranges::is_sorted(events, {}, &ecs::instrumentation::Event::beginNs_));
+		for (const std::uint64_t eachFrame : { frame, frame + 1U })
+		{
+			const ecs::instrumentation::FrameStats stats{ ecs::instrumentation::frame_stats(events, eachFrame) };
+			REQUIRE(stats.systems_.size() == 2U);
+
+			const auto move{ std::ranges::find(stats.systems_, std::string_view{ "move_system" }, 
+				[](const ecs::instrumentation::SystemStats& system) { return std::string_view{ system.name_ }; }) };
+			const auto lifetime{ std::ranges::find(stats.systems_, std::string_view{ "decrease_lifetime_system" },
+				[](const ecs::instrumentation::SystemStats& system) { return std::string_view{ system.name_ }; }) };
+			REQUIRE(move != stats.systems_.end());
+			REQUIRE(lifetime != stats.systems_.end());
+			REQUIRE(move->runs_ == 1U);
+			REQUIRE(move->entities_ == 3U);
+			REQUIRE(lifetime->runs_ == 1U);
+			REQUIRE(lifetime->entities_ == 2U);
+			REQUIRE(move->wallTime_.count() >= 0);
+		}
+		REQUIRE(ecs::instrumentation::drain_events().empty());
+	}
+
+	SECTION("chunks and playbacks are exported to a chrome trace")
+	{
+		constexpr std::size_t capacity{ 2U * ecs::defaultChunkSlots };
+		using Manager = EntitiesManager<capacity>;
+
+		auto entitiesManager{ std::make_unique<Manager>() };
+		std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(capacity) };
+		for (auto [owner, lifetimeComp] : entitiesManager->owned<ecs::LifetimeComponent>())
+		{
+			lifetimeComp.lifetime = 1U;
+		}
+
+		ecs::ThreadPool threadPool{ 2U };
+		ecs::CommandBuffer<capacity, ecs::PhysicsComponent, ecs::LifetimeComponent> commands{ *entitiesManager, threadPool };
+		ecs::parallel_decrease_lifetime_system(*entitiesManager, threadPool, commands);
+		REQUIRE(commands.playback(ents) == capacity);
+
+		const std::vector<ecs::instrumentation::Event> events{ ecs::instrumentation::drain_events() };
+		std::uint64_t chunkSlots{ 0U };
+		for (const ecs::instrumentation::Event& event : events)
+		{
+			if (event.kind_ == ecs::instrumentation::EventKind::chunk)
+			{
+				REQUIRE(std::string_view{ event.name_ } == "parallel_decrease_lifetime_system");
+				chunkSlots += event.entities_;
+			}
+		}
+		REQUIRE(chunkSlots == capacity);
+		REQUIRE(std::ranges::count(events, ecs::instrumentation::EventKind::commandFlush, &ecs::instrumentation::Event::kind_) == 1);
+		REQUIRE(ecs::instrumentation::frame_stats(events, events.front().frame_).systems_.size() == 1U);
+
+		std::ostringstream trace{};
+		ecs::instrumentation::write_chrome_trace(trace, events);
+		const std::string json{ trace.str() };
+		REQUIRE(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+		REQUIRE(json.find("\"cat\":\"system\"") != std::string::npos);
+		REQUIRE(json.find("\"cat\":\"chunk\"") != std::string::npos);
+		REQUIRE(json.find("\"name\":\"CommandBuffer::playback\",\"cat\":\"commandFlush\"") != std::string::npos);
+		REQUIRE(json.ends_with("]}\n"));
+	}
+
+	SECTION("names are grouped by their contents")
+	{
+		// the same name at two addresses, as when it's spelled out in two translation units
+		const std::string first{ "system" };
+		const std::string second{ "system" };
+		const std::array<ecs::instrumentation::Event, 3U> events{
+			ecs::instrumentation::Event{ first.c_str(), ecs::instrumentation::EventKind::system, 0U, 7U, 0, 10, 1U },
+			ecs::instrumentation::Event{ second.c_str(), ecs::instrumentation::EventKind::system, 1U, 7U, 5, 25, 2U },
+			ecs::instrumentation::Event{ second.c_str(), ecs::instrumentation::EventKind::lockWait, 1U, 7U, 25, 30, 0U } };
+
+		const ecs::instrumentation::FrameStats stats{ ecs::instrumentation::frame_stats(events, 7U) };
+		REQUIRE(stats.systems_.size() == 1U);
+		REQUIRE(stats.systems_.front().runs_ == 2U);
+		REQUIRE(stats.systems_.front().entities_ == 3U);
+		REQUIRE(stats.systems_.front().wallTime_ == std::chrono::nanoseconds{ 30 });
+		REQUIRE(stats.locks_.size() == 1U);
+		REQUIRE(stats.locks_.front().waits_ == 1U);
+	}
+
+	SECTION("only contended locks are recorded")
+	{
+		std::mutex mutex{};
+		{
+			const auto lock{ ecs::instrumentation::timed_lock(mutex, "test lock") };
+		}
+		REQUIRE(ecs::instrumentation::drain_events().empty());
+
+		mutex.lock();
+		std::thread waiter{ [&mutex]()
+			{
+				const auto lock{ ecs::instrumentation::timed_lock(mutex, "test lock") };
+			} };
+		std::this_thread::sleep_for(std::chrono::milliseconds{ 20 });
+		mutex.unlock();
+		waiter.join();
+
+		const std::vector<ecs::instrumentation::Event> events{ ecs::instrumentation::drain_events() };
+		REQUIRE(events.size() == 1U);
+		REQUIRE(events.front().kind_ == ecs::instrumentation::EventKind::lockWait);
+
+		const ecs::instrumentation::FrameStats stats{ ecs::instrumentation::frame_stats(events, events.front().frame_) };
+		REQUIRE(stats.systems_.empty());
+		REQUIRE(stats.locks_.size() == 1U);
+		REQUIRE(stats.locks_.front().waits_ == 1U);
+		REQUIRE(stats.locks_.front().waitTime_ >= std::chrono::milliseconds{ 10 });
+	}
+}
+
+TEST_CASE("ArchetypeStorage")
+{
+	using Storage = ecs::ArchetypeStorage<2000U, ecs::PhysicsComponent, ecs::LifetimeComponent>;
+	auto storage{ std::make_unique<Storage>() };
+
+	// enough entities for several chunks per archetype
+	std::vector<ecs::EntityId> movers{};
+	std::vector<ecs::EntityId> mortals{};
+	for (std::size_t i{ 0U }; i != 900U; ++i)
+	{
+		movers.push_back(storage->create<ecs::PhysicsComponent, ecs::LifetimeComponent>());
+		storage->get<ecs::PhysicsComponent>(movers.back())->xPos = static_cast<float>(i);
+		storage->get<ecs::LifetimeComponent>(movers.back())->lifetime = static_cast<std::uint32_t>(i);
+
+		mortals.push_back(storage->create<ecs::LifetimeComponent>());
+		storage->get<ecs::LifetimeComponent>(mortals.back())->lifetime = 5U;
+	}
+	const ecs::EntityId bare{ storage->create() };
+	REQUIRE(storage->size() == 1801U);
+	REQUIRE(storage->archetypesCount() == 3U);
+	REQUIRE(storage->get<ecs::PhysicsComponent>(bare) == nullptr);
+	REQUIRE(storage->get<ecs::PhysicsComponent>(mortals[0]) == nullptr);
+
+	// chunks are filled up to 16 KiB
+	std::size_t chunks{ 0U };
+	storage->forEachChunk<ecs::PhysicsComponent>([&chunks](std::span<const ecs::EntityId> ids, std::span<ecs::PhysicsComponent> physics)
+		{
+			REQUIRE(ids.size() == physics.size());
+			REQUIRE(reinterpret_cast<std::uintptr_t>(physics.data()) % 64U == 0U);
+			++chunks;
+		});
+	REQUIRE(chunks == (900U * (sizeof(ecs::EntityId) + sizeof(ecs::PhysicsComponent) + sizeof(ecs::LifetimeComponent))) / Storage::chunkBytes_s + 1U);
+
+	std::size_t visited{ 0U };
+	storage->forEach<ecs::LifetimeComponent>([&visited](ecs::LifetimeComponent& lifetimeComp) { --lifetimeComp.lifetime; ++visited; });
+	REQUIRE(visited == 1800U);
+
+	// destroying moves the archetype's last row into the hole
+	storage->destroy(movers[10]);
+	REQUIRE(storage->get<ecs::PhysicsComponent>(movers.back())->xPos == 899.0f);
+
+	// a destroyed id is ignored until its slot is reused
+	REQUIRE_FALSE(storage->isAlive(movers[10]));
+	REQUIRE_FALSE(storage->has<ecs::PhysicsComponent>(movers[10]));
+	REQUIRE(storage->get<ecs::PhysicsComponent>(movers[10]) == nullptr);
+	REQUIRE_FALSE(storage->add<ecs::PhysicsComponent>(movers[10]));
+	REQUIRE_FALSE(storage->remove<ecs::PhysicsComponent>(movers[10]));
+	storage->destroy(movers[10]);
+	REQUIRE(storage->size() == 1800U);
+	REQUIRE_FALSE(storage->isAlive(static_cast<ecs::EntityId>(2000U)));
+	REQUIRE(storage->get<ecs::LifetimeComponent>(static_cast<ecs::EntityId>(2000U)) == nullptr);
+
+	// removing and adding components moves rows between archetypes, keeping the values of the others
+	REQUIRE(storage->remove<ecs::PhysicsComponent>(movers[20]));
+	REQUIRE_FALSE(storage->remove<ecs::PhysicsComponent>(movers[20]));
+	REQUIRE_FALSE(storage->has<ecs::PhysicsComponent>(movers[20]));
+	REQUIRE(storage->get<ecs::LifetimeComponent>(movers[20])->lifetime == 19U);
+
+	REQUIRE(storage->add<ecs::PhysicsComponent>(movers[20]));
+	REQUIRE_FALSE(storage->add<ecs::PhysicsComponent>(movers[20]));
+	REQUIRE(storage->get<ecs::PhysicsComponent>(movers[20])->xPos == 0.0f);
+	REQUIRE(storage->get<ecs::LifetimeComponent>(movers[20])->lifetime == 19U);
+
+	REQUIRE(storage->add<ecs::PhysicsComponent>(bare));
+	REQUIRE(storage->archetypesCount() == 4U);
+
+	float xSum{ 0.0f };
+	std::size_t pairs{ 0U };
+	storage->forEach<ecs::PhysicsComponent, ecs::LifetimeComponent>(
+		[&](ecs::PhysicsComponent& physComp, ecs::LifetimeComponent&) { xSum += physComp.xPos; ++pairs; });
+	REQUIRE(pairs == 899U);
+	REQUIRE(xSum == static_cast<float>(899U * 900U / 2U - 10U - 20U));
+
+	for (std::size_t i{ 0U }; i != movers.size(); ++i)
+	{
+		if (i != 10U)
+		{
+			REQUIRE(storage->get<ecs::LifetimeComponent>(movers[i])->lifetime == static_cast<std::uint32_t>(i) - 1U);
+		}
+	}
+
+	while (!storage->isFull())
+	{
+		static_cast<void>(storage->create());
+	}
+	REQUIRE_THROWS_AS(storage->create(), ecs::entities_max_capacity_exception);
+}
+
+// the largest component a chunk holds a row of next to a LifetimeComponent, both columns and the ids' cache line aligned
+struct ChunkSizedComponent
+{
+	std::array<std::byte, ecs::ArchetypeStorage<1U>::chunkBytes_s - 2U * 64U> bytes;
+};
+
+TEST_CASE("ArchetypeStorage::rows as large as a chunk")
+{
+	// larger rows are refused at compile time, rather than leaving archetypes with no rows per chunk
+	using Storage = ecs::ArchetypeStorage<8U, ChunkSizedComponent, ecs::LifetimeComponent>;
+	auto storage{ std::make_unique<Storage>() };
+
+	std::vector<ecs::EntityId> ids{};
+	for (std::size_t i{ 0U }; i != 3U; ++i)
+	{
+		ids.push_back(storage->create<ChunkSizedComponent>());
+		storage->get<ChunkSizedComponent>(ids.back())->bytes.back() = static_cast<std::byte>(i);
+	}
+	REQUIRE(storage->add<ecs::LifetimeComponent>(ids[1]));
+
+	std::size_t chunks{ 0U };
+	storage->forEachChunk<ChunkSizedComponent>([&chunks](std::span<const ecs::EntityId> chunkIds, std::span<ChunkSizedComponent> compos)
+		{
+			REQUIRE(chunkIds.size() == 1U);
+			REQUIRE(compos.front().bytes.back() == static_cast<std::byte>(chunkIds.front()));
+			++chunks;
+		});
+	REQUIRE(chunks == 3U);
+
+	storage->destroy(ids[0]);
+	REQUIRE(storage->get<ChunkSizedComponent>(ids[2])->bytes.back() == std::byte{ 2U });
+	REQUIRE(storage->get<ChunkSizedComponent>(ids[1])->bytes.back() == std::byte{ 1U });
+}
+
+
+TEST_CASE("EntitiesManager::view")
+{
+	constexpr std::size_t capacity{ 64U };
+	auto entitiesManager{ std::make_unique<EntitiesManager<capacity>>() };
+
+	std::vector<EntitiesManager<capacity>::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(40U) };
+	for (std::size_t i{ 0U }; i != ents.size(); ++i)
+	{
+		std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(ents[i].getComponent<ecs::LifetimeComponent>())->lifetime = static_cast<std::uint32_t>(i);
+		if (i % 4U == 0U)
+		{
+			REQUIRE(ents[i].addComponent<ecs::PhysicsComponent>());
+		}
+		if (i % 8U == 0U)
+		{
+			REQUIRE(ents[i].enrollToGroup(ecs::Group::movers));
+		}
+	}
+
+	// a released component's slot is reused by another entity, which must be yielded instead
+	REQUIRE(ents[4].removeComponent<ecs::PhysicsComponent>());
+	REQUIRE(ents[5].addComponent<ecs::PhysicsComponent>());
+
+	// references to the components themselves, a proxy to the columns of structure-of-arrays ones
+	using View = EntitiesManager<capacity>::View<ecs::PhysicsComponent, ecs::LifetimeComponent>;
+	static_assert(std::is_same_v<View::value_type, std::tuple<ecs::SoaReference<ecs::PhysicsComponent, capacity>, ecs::LifetimeComponent&>>);
+
+	std::vector<std::uint32_t> lifetimes{};
+	for (auto [physComp, lifetimeComp] : entitiesManager->view<ecs::PhysicsComponent, ecs::LifetimeComponent>())
+	{
+		physComp.xPos = static_cast<float>(lifetimeComp.lifetime);
+		lifetimes.push_back(lifetimeComp.lifetime);
+	}
+	std::ranges::sort(lifetimes);
+	REQUIRE(lifetimes == std::vector<std::uint32_t>{ 0U, 5U, 8U, 12U, 16U, 20U, 24U, 28U, 32U, 36U });
+	REQUIRE(std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(ents[12].getComponent<ecs::PhysicsComponent>())->xPos == 12.0f);
+
+	lifetimes.clear();
+	for (auto [lifetimeComp, physComp] : entitiesManager->view<ecs::LifetimeComponent, ecs::PhysicsComponent>().with(ecs::Group::movers))
+	{
+		lifetimes.push_back(lifetimeComp.lifetime);
+	}
+	std::ranges::sort(lifetimes);
+	REQUIRE(lifetimes == std::vector<std::uint32_t>{ 0U, 8U, 16U, 24U, 32U });
+
+	REQUIRE(ents[16].enrollToGroup(ecs::Group::organisms));
+	std::size_t count{ 0U };
+	for (auto [physComp] : entitiesManager->view<ecs::PhysicsComponent>().with(ecs::Group::movers).with(ecs::Group::organisms))
+	{
+		REQUIRE(physComp.xPos == 16.0f);
+		++count;
+	}
+	REQUIRE(count == 1U);
+
+	// an iterator outlives the temporary views it was taken from
+	auto organismMover{ entitiesManager->view<ecs::PhysicsComponent>().with(ecs::Group::movers).with(ecs::Group::organisms).begin() };
+	auto allMovers{ entitiesManager->view<ecs::PhysicsComponent>().with(ecs::Group::movers).begin() };
+	REQUIRE(std::get<0U>(*organismMover).xPos == 16.0f);
+	REQUIRE(++organismMover == std::default_sentinel);
+	REQUIRE(std::ranges::distance(allMovers, std::default_sentinel) == 5);
+
+	// every entity holds a LifetimeComponent, so the entities are walked rather than the pool
+	REQUIRE(std::ranges::distance(entitiesManager->view<ecs::LifetimeComponent>().begin(), std::default_sentinel) == 40);
+	REQUIRE(std::ranges::distance(entitiesManager->view<ecs::LifetimeComponent>().with(ecs::Group::movers).begin(), std::default_sentinel) == 5);
+
+	entitiesManager->releaseEntities(std::move(ents));
+	REQUIRE(entitiesManager->view<ecs::LifetimeComponent>().begin() == std::default_sentinel);
+}
+
+TEST_CASE("EntitiesManager::snapshot")
+{
+	constexpr std::size_t capacity{ 64U };
+	using Manager = EntitiesManager<capacity>;
+	auto entitiesManager{ std::make_unique<Manager>() };
+
+	std::vector<Manager::Entity> ents{ entitiesManager->requestEntities<ecs::LifetimeComponent>(40U) };
+	for (std::size_t i{ 0U }; i != ents.size(); ++i)
+	{
+		std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(ents[i].getComponent<ecs::LifetimeComponent>())->lifetime = static_cast<std::uint32_t>(i);
+		if (i % 3U == 0U)
+		{
+			REQUIRE(ents[i].addComponent<ecs::PhysicsComponent>());
+			std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(ents[i].getComponent<ecs::PhysicsComponent>())->xPos = static_cast<float>(i);
+		}
+		if (i % 4U == 0U)
+		{
+			REQUIRE(ents[i].enrollToGroup(ecs::Group::movers));
+		}
+		if (i % 5U == 0U)
+		{
+			REQUIRE(ents[i].enrollToGroup(ecs::Group::organisms));
+		}
+	}
+
+	// free slots on the pools' stacks and in a magazine, and generations bumped by releases
+	REQUIRE(ents[9].removeComponent<ecs::PhysicsComponent>());
+	const ecs::EntityHandle stale{ ents.back().getHandle() };
+	ents.pop_back();
+	std::vector<Manager::Entity> released{};
+	for (std::size_t i{ 0U }; i != 4U; ++i)
+	{
+		released.push_back(std::move(ents.back()));
+		ents.pop_back();
+	}
+	entitiesManager->releaseEntities(std::move(released));
+
+	std::stringstream snapshot{};
+	entitiesManager->save(snapshot);
+
+	auto loadedManager{ std::make_unique<Manager>() };
+	std::vector<Manager::Entity> loaded{ loadedManager->load(snapshot) };
+
+	REQUIRE(loaded.size() == ents.size());
+	REQUIRE(loadedManager->componentPool<ecs::PhysicsComponent>().size() == entitiesManager->componentPool<ecs::PhysicsComponent>().size());
+	REQUIRE(loadedManager->componentPool<ecs::LifetimeComponent>().size() == ents.size());
+	REQUIRE(loadedManager->entitiesPool().membersCount(ecs::Group::movers) == entitiesManager->entitiesPool().membersCount(ecs::Group::movers));
+	REQUIRE_FALSE(loadedManager->isAlive(stale));
+
+	// requested in one batch, the entities took slots in order, and come back in slot order
+	for (std::size_t i{ 0U }; i != ents.size(); ++i)
+	{
+		REQUIRE(loaded[i].getId() == ents[i].getId());
+		REQUIRE(loaded[i].getHandle() == ents[i].getHandle());
+		REQUIRE(loaded[i].isMemberOf(ecs::Group::movers) == ents[i].isMemberOf(ecs::Group::movers));
+		REQUIRE(loaded[i].isMemberOf(ecs::Group::organisms) == ents[i].isMemberOf(ecs::Group::organisms));
+		REQUIRE(std::get<ecs::PooledComponent<ecs::LifetimeComponent, capacity>>(loaded[i].getComponent<ecs::LifetimeComponent>())->lifetime == i);
+		REQUIRE(loaded[i].hasComponent<ecs::PhysicsComponent>() == ents[i].hasComponent<ecs::PhysicsComponent>());
+		if (loaded[i].hasComponent<ecs::PhysicsComponent>())
+		{
+			REQUIRE(std::get<ecs::PooledComponent<ecs::PhysicsComponent, capacity>>(loaded[i].getComponent<ecs::PhysicsComponent>())->xPos == static_cast<float>(i));
+			REQUIRE(loadedManager->ownerOf<ecs::PhysicsComponent>(loadedManager->componentOf<ecs::PhysicsComponent>(loaded[i].getHandle())) == loaded[i].getHandle());
+		}
+	}
+
+	std::size_t moversCount{ 0U };
+	for (auto [lifetimeComp, physComp] : loadedManager->view<ecs::LifetimeComponent, ecs::PhysicsComponent>().with(ecs::Group::movers))
+	{
+		REQUIRE(lifetimeComp.lifetime % 12U == 0U);
+		++moversCount;
+	}
+	REQUIRE(moversCount == 3U);
+
+	// both go on to hand out the same slots
+	for (std::size_t i{ 0U }; i != 3U; ++i)
+	{
+		Manager::Entity& ent{ ents.emplace_back(entitiesManager->requestEntity()) };
+		Manager::Entity& loadedEnt{ loaded.emplace_back(loadedManager->requestEntity()) };
+		REQUIRE(loadedEnt.getHandle() == ent.getHandle());
+		REQUIRE(loadedEnt.getId() != ent.getId());
+
+		REQUIRE(ent.addComponent<ecs::PhysicsComponent>());
+		REQUIRE(loadedEnt.addComponent<ecs::PhysicsComponent>());
+		REQUIRE(loadedManager->componentOf<ecs::PhysicsComponent>(loadedEnt.getHandle()).slot() ==
+			entitiesManager->componentOf<ecs::PhysicsComponent>(ent.getHandle()).slot());
+	}
+
+	SECTION("damaged and foreign snapshots are refused")
+	{
+		const std::string bytes{ snapshot.str() };
+
+		std::string otherVersion{ bytes };
+		otherVersion[ecs::snapshot::magic.size()] ^= 0x7F;
+		std::istringstream otherVersionIn{ otherVersion };
+		REQUIRE_THROWS_AS(static_cast<void>(std::make_unique<Manager>()->load(otherVersionIn)), ecs::snapshot_exception);
+
+		std::istringstream truncatedIn{ bytes.substr(0U, bytes.size() - 1U) };
+		REQUIRE_THROWS_AS(static_cast<void>(std::make_unique<Manager>()->load(truncatedIn)), ecs::snapshot_exception);
+
+		std::istringstream otherCapacityIn{ bytes };
+		REQUIRE_THROWS_AS(static_cast<void>(std::make_unique<EntitiesManager<2U * capacity>>()->load(otherCapacityIn)), ecs::snapshot_exception);
+
+		std::istringstream reloadIn{ bytes };
+		REQUIRE_THROWS_AS(static_cast<void>(loadedManager->load(reloadIn)), ecs::snapshot_exception);
+	}
+
+	loadedManager->releaseEntities(std::move(loaded));
+	REQUIRE(loadedManager->size() == 0U);
+	REQUIRE(loadedManager->componentPool<ecs::PhysicsComponent>().size() == 0U);
+}